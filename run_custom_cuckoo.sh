@@ -0,0 +1,81 @@
+#!/bin/bash
+
+# Check if all required arguments are provided
+if [ $# -ne 1 ]; then
+    echo "Error: Missing arguments"
+    echo "Usage: $0 <file_name>"
+    exit 1
+fi
+
+TESTING_HW="cuckoo"
+TESTING_FILE=$1
+ENGINE_FLAG=${ENGINE:+--engine=$ENGINE} # ENGINE=lockfree, hopscotch, robinhood, delegated, locked, sharded or tbb picks another set engine
+RESULT_NAME=$TESTING_FILE${ENGINE:+-$ENGINE}$RUN_TAG # RUN_TAG tells variants apart, e.g. RUN_TAG=-huge
+OUTPUT_CSV_FILE="results/$TESTING_HW/$RESULT_NAME.csv" # Output CSV file
+OUTPUT_TXT_FILE="results/$TESTING_HW/$RESULT_NAME.txt" # Output TXT file
+LATENCY_CSV_FILE="results/$TESTING_HW/$RESULT_NAME-latency.csv" # Percentiles per op type, from a batch size 1 pass
+TELEMETRY_CSV_FILE="results/$TESTING_HW/$RESULT_NAME-telemetry.csv" # Table internals
+
+OPERATIONS=(1000 10000 100000 1000000 10000000)
+THREADS=(2 4 8 16)
+
+# Clear CSV, write header
+echo "Implementation,Operations,Threads,Time(μs)" > "$OUTPUT_CSV_FILE"
+echo "Implementation,Operations,Threads,Op,Count,P50(ns),P99(ns),P99.9(ns),Max(ns)" > "$LATENCY_CSV_FILE"
+echo "Implementation,Operations,Threads,Kick0,Kick1,Kick2,Kick3,Kick4,Kick5+,RelocateFailures,Resizes,ResizeTime(μs),Reseeds,ReseedTime(μs),StashInserts,StashHits,LockWaits,LockWaitTime(μs)" > "$TELEMETRY_CSV_FILE"
+echo "testing $TESTING_FILE"
+
+# Clear TXT
+echo "" > "$OUTPUT_TXT_FILE"
+
+# Compile; ALLOC_FLAGS="-DHUGE_PAGES" (or "-DNUMA_INTERLEAVE") puts the
+# tables on huge pages, TABLES=3 or 4 selects d-ary cuckoo, SHARDS=N sets
+# the shard count of the sharded baseline, SERVERS=N the server threads of
+# the delegated set (one per core by default). ENGINE=tbb builds against the
+# oneTBB tree the kmeans scripts use.
+mkdir -p bin/$TESTING_HW
+SIMD_FLAGS="-mavx2"
+TABLES_FLAGS="-DCUCKOO_TABLES=${TABLES:-2} -DBASELINE_SHARDS=${SHARDS:-64} -DDELEGATED_SERVERS=${SERVERS:-0}"
+if [ "$ENGINE" == "tbb" ]; then
+    IFLAGS="-DWITH_TBB -I oneapi-tbb-2022.0.0/include"
+    LFLAGS="-L oneapi-tbb-2022.0.0/lib/intel64/gcc4.8 -ltbb"
+fi
+g++ -std=c++17 -O3 $SIMD_FLAGS $ALLOC_FLAGS $TABLES_FLAGS $IFLAGS src/$TESTING_HW/${TESTING_FILE} -o bin/$TESTING_HW/${TESTING_FILE} $LFLAGS -lpthread
+
+if [ $? -ne 0 ]; then
+    echo "Compilation failed"
+    exit 1
+fi
+
+for op in "${OPERATIONS[@]}"; do
+    for thread in "${THREADS[@]}"; do
+        echo "[DEBUG] Running $TESTING_FILE with: $thread Threads, $op Operations"
+
+        # Write full output to txt file
+        echo "[DEBUG] Running $TESTING_FILE with: $thread Threads, $op Operations" >> "$OUTPUT_TXT_FILE"
+        # PERF_EVENTS="dTLB-load-misses,dTLB-loads" appends perf counters;
+        # CUCKOO_SNAPSHOT=<file> reuses one populated table across runs;
+        # WORKLOAD_FLAGS="--dist=zipf --hit=0.9" etc. sets the workload
+        if [ -n "$PERF_EVENTS" ]; then
+            OUTPUT=$(perf stat -e "$PERF_EVENTS" -o "$OUTPUT_TXT_FILE" --append ./bin/$TESTING_HW/$TESTING_FILE "$op" "$thread" $ENGINE_FLAG $WORKLOAD_FLAGS)
+        else
+            OUTPUT=$(./bin/$TESTING_HW/$TESTING_FILE "$op" "$thread" $ENGINE_FLAG $WORKLOAD_FLAGS)
+        fi
+        echo "$OUTPUT" >> "$OUTPUT_TXT_FILE"
+
+        # Strip first only slowest thread time from output and put into csv
+        total_time=$(echo "$OUTPUT" | grep 'Total time:'    | cut -d' ' -f3)
+        echo "$RESULT_NAME,$op,$thread,$total_time" >> "$OUTPUT_CSV_FILE"
+        echo "$OUTPUT" | grep '^Telemetry,' | sed "s/^Telemetry,/$RESULT_NAME,$op,$thread,/" >> "$TELEMETRY_CSV_FILE"
+
+        # Latencies only mean something per operation, so they come from a
+        # second pass that issues every operation on its own
+        LATENCY_OUTPUT=$(./bin/$TESTING_HW/$TESTING_FILE "$op" "$thread" 1 $ENGINE_FLAG $WORKLOAD_FLAGS)
+        echo "$LATENCY_OUTPUT" | grep '^Latency,' | sed "s/^Latency,/$RESULT_NAME,$op,$thread,/" >> "$LATENCY_CSV_FILE"
+
+        # Print to terminal
+        echo "$OUTPUT"
+    done
+done
+
+echo "All tests completed. Results saved in $OUTPUT_CSV_FILE and $OUTPUT_TXT_FILE"
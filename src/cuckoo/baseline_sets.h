@@ -0,0 +1,186 @@
+// Reference engines for the cuckoo driver, to anchor its numbers: a
+// std::unordered_set behind one mutex, one split into mutex-guarded shards,
+// and, with -DWITH_TBB, TBB's concurrent_hash_map. They have the
+// interface of StripedCuckooHashSet that the harness (benchmark.h) needs.
+//
+// Standard containers do not report their footprint, so memoryBytes()
+// estimates it: one pointer per bucket plus one heap node per key, sized
+// the way glibc's malloc rounds it.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include "hash_policy.h"
+#ifdef WITH_TBB
+#include <tbb/concurrent_hash_map.h>
+#endif
+
+// Heap bytes of a hash node holding `payload` bytes: glibc adds an 8-byte
+// header and rounds up to 16, with 32 bytes at least
+static inline size_t heapNodeBytes(size_t payload) {
+    return std::max<size_t>(32, (payload + 8 + 15) / 16 * 16);
+}
+
+// std::unordered_set behind a single mutex
+template<typename T>
+class LockedHashSet {
+public:
+    LockedHashSet(int initialCapacity) {
+        set.reserve(initialCapacity);
+    }
+
+    bool add(T x) {
+        std::lock_guard<std::mutex> lk(lock);
+        return set.insert(x).second;
+    }
+
+    bool remove(T x) {
+        std::lock_guard<std::mutex> lk(lock);
+        return set.erase(x) == 1;
+    }
+
+    bool contains(T x) const {
+        std::lock_guard<std::mutex> lk(lock);
+        return set.count(x) == 1;
+    }
+
+    int size() const {
+        std::lock_guard<std::mutex> lk(lock);
+        return set.size();
+    }
+
+    // Keys it holds before it rehashes
+    int getCapacity() const {
+        std::lock_guard<std::mutex> lk(lock);
+        return set.bucket_count() * set.max_load_factor();
+    }
+
+    size_t memoryBytes() const {
+        std::lock_guard<std::mutex> lk(lock);
+        return sizeof(*this) + set.bucket_count() * sizeof(void*) + set.size() * heapNodeBytes(sizeof(void*) + sizeof(T));
+    }
+
+private:
+    mutable std::mutex lock;
+    std::unordered_set<T> set;
+};
+
+// SHARDS std::unordered_sets, each behind its own mutex; the shard of a key
+// comes from a hash policy, so consecutive keys spread over all of them
+template<typename T, int SHARDS = 64, typename Hash = MurmurHash>
+class ShardedHashSet {
+    static_assert(SHARDS > 0 && (SHARDS & (SHARDS - 1)) == 0, "shard count is a power of two");
+
+public:
+    ShardedHashSet(int initialCapacity, uint64_t seed = 714) : hash(seed) {
+        for (Shard& s : shards) s.set.reserve(initialCapacity / SHARDS + 1);
+    }
+
+    bool add(T x) {
+        Shard& s = shardOf(x);
+        std::lock_guard<std::mutex> lk(s.lock);
+        return s.set.insert(x).second;
+    }
+
+    bool remove(T x) {
+        Shard& s = shardOf(x);
+        std::lock_guard<std::mutex> lk(s.lock);
+        return s.set.erase(x) == 1;
+    }
+
+    bool contains(T x) const {
+        const Shard& s = shardOf(x);
+        std::lock_guard<std::mutex> lk(s.lock);
+        return s.set.count(x) == 1;
+    }
+
+    int size() const {
+        return sum([](const std::unordered_set<T>& set) { return set.size(); });
+    }
+
+    // Keys the shards hold before any of them rehashes
+    int getCapacity() const {
+        return sum([](const std::unordered_set<T>& set) { return set.bucket_count() * set.max_load_factor(); });
+    }
+
+    size_t memoryBytes() const {
+        return sizeof(*this) + sum([](const std::unordered_set<T>& set) {
+                   return set.bucket_count() * sizeof(void*) + set.size() * heapNodeBytes(sizeof(void*) + sizeof(T));
+               });
+    }
+
+private:
+    struct alignas(64) Shard {
+        mutable std::mutex lock;
+        std::unordered_set<T> set;
+    };
+
+    Shard& shardOf(T x) {
+        return shards[hash(x, 0) & (SHARDS - 1)];
+    }
+
+    const Shard& shardOf(T x) const {
+        return shards[hash(x, 0) & (SHARDS - 1)];
+    }
+
+    template<typename F>
+    size_t sum(F f) const {
+        size_t n = 0;
+        for (const Shard& s : shards) {
+            std::lock_guard<std::mutex> lk(s.lock);
+            n += f(s.set);
+        }
+        return n;
+    }
+
+    Hash hash;
+    Shard shards[SHARDS];
+};
+
+#ifdef WITH_TBB
+// tbb::concurrent_hash_map with an empty value, TBB's only concurrent table
+// that erases concurrently: each bucket has its own reader-writer lock, and
+// inserts, lookups and erases take only the locks of the buckets they use
+template<typename T>
+class TbbHashSet {
+    struct Empty {};
+    using Map = tbb::concurrent_hash_map<T, Empty>;
+
+public:
+    TbbHashSet(int initialCapacity) : set(initialCapacity) {}
+
+    bool add(T x) {
+        return set.insert(typename Map::value_type(x, Empty()));
+    }
+
+    bool remove(T x) {
+        return set.erase(x);
+    }
+
+    bool contains(T x) const {
+        return set.count(x) == 1;
+    }
+
+    int size() const {
+        return set.size();
+    }
+
+    // Keys it holds before it adds buckets, which it does at one per key
+    int getCapacity() const {
+        return set.bucket_count();
+    }
+
+    // A bucket is a lock and a list head; a node adds a next pointer and a
+    // lock of its own to the key
+    size_t memoryBytes() const {
+        return sizeof(*this) + set.bucket_count() * 2 * sizeof(void*) +
+               set.size() * heapNodeBytes(2 * sizeof(void*) + sizeof(typename Map::value_type));
+    }
+
+private:
+    Map set;
+};
+#endif
@@ -0,0 +1,283 @@
+// Benchmark harness of our cuckoo drivers, shared by every set engine: runs
+// the workload (workload.h) from several threads and prints the same output
+// block as the generated implementations, so the timing scripts work. After
+// that block it prints per-operation latency percentiles, in runs with a
+// batch size of 1, and, for engines that count them, the table's internal
+// counters (telemetry.h) as "Latency," and "Telemetry," CSV rows, which
+// run_custom_cuckoo.sh collects next to its timing CSV.
+//
+// An engine needs add, remove, contains, size, getCapacity and memoryBytes.
+// The prefetching batch calls, bulk_load, save/load and counters() are used
+// where it has them.
+#pragma once
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "telemetry.h"
+#include "workload.h"
+
+// Command line: <operations> <threads> [batch size] [--engine=E] followed by
+// the workload flags. Throws std::invalid_argument.
+struct BenchmarkArgs {
+    int operations;
+    int threads;
+    int batchSize = 32;
+    std::string engine;
+    std::unique_ptr<Workload> workload;
+
+    BenchmarkArgs(int argc, char* argv[], const std::string& defaultEngine) : engine(defaultEngine) {
+        if (argc < 3) throw std::invalid_argument("missing arguments");
+        operations = std::atoi(argv[1]);
+        threads = std::atoi(argv[2]);
+        // Every worker and this thread take a ThreadIds id (epoch.h); a
+        // worker past the limit would throw where nothing catches it
+        if (threads < 1 || threads >= ThreadIds::MAX) {
+            throw std::invalid_argument("<threads> must lie in [1, " + std::to_string(ThreadIds::MAX - 1) + "]");
+        }
+
+        bool hasBatch = argc >= 4 && std::strncmp(argv[3], "--", 2) != 0;
+        if (hasBatch) batchSize = std::max(1, std::atoi(argv[3]));
+
+        std::vector<char*> flags = {argv[0]};
+        for (int i = hasBatch ? 4 : 3; i < argc; i++) {
+            if (std::strncmp(argv[i], "--engine=", 9) == 0) {
+                engine = argv[i] + 9;
+            } else {
+                flags.push_back(argv[i]);
+            }
+        }
+        workload.reset(new Workload(flags.size(), flags.data(), 1));
+    }
+
+    static std::string usage(const char* program, const char* engines) {
+        return std::string(program) + " <operations> <threads> [batch size] [--engine=" + engines + "] " +
+               Workload::usage();
+    }
+};
+
+namespace benchmark_detail {
+
+template<typename Set, typename = void>
+struct HasBatch : std::false_type {};
+
+template<typename Set>
+struct HasBatch<Set, std::void_t<decltype(std::declval<Set&>().contains_batch(
+                         std::declval<const int*>(), 0, std::declval<bool*>()))>> : std::true_type {};
+
+template<typename Set, typename = void>
+struct HasBulkLoad : std::false_type {};
+
+template<typename Set>
+struct HasBulkLoad<Set, std::void_t<decltype(std::declval<Set&>().bulk_load(
+                            std::declval<const int*>(), std::declval<const int*>()))>> : std::true_type {};
+
+template<typename Set, typename = void>
+struct HasSnapshot : std::false_type {};
+
+template<typename Set>
+struct HasSnapshot<Set, std::void_t<decltype(std::declval<Set&>().load(std::declval<const char*>()))>>
+    : std::true_type {};
+
+template<typename Set, typename = void>
+struct HasCounters : std::false_type {};
+
+template<typename Set>
+struct HasCounters<Set, std::void_t<decltype(std::declval<const Set&>().counters())>> : std::true_type {};
+
+template<typename Set>
+void containsAll(Set& set, const int* keys, int n, bool* results) {
+    if constexpr (HasBatch<Set>::value) {
+        set.contains_batch(keys, n, results);
+    } else {
+        for (int i = 0; i < n; i++) results[i] = set.contains(keys[i]);
+    }
+}
+
+template<typename Set>
+void addAll(Set& set, const int* keys, int n, bool* results) {
+    if constexpr (HasBatch<Set>::value) {
+        set.add_batch(keys, n, results);
+    } else {
+        for (int i = 0; i < n; i++) results[i] = set.add(keys[i]);
+    }
+}
+
+template<typename Set>
+void removeAll(Set& set, const int* keys, int n, bool* results) {
+    if constexpr (HasBatch<Set>::value) {
+        set.remove_batch(keys, n, results);
+    } else {
+        for (int i = 0; i < n; i++) results[i] = set.remove(keys[i]);
+    }
+}
+
+}  // namespace benchmark_detail
+
+// Populate the set with the workload's prefill keys (500,000 by default).
+// CUCKOO_SNAPSHOT=<file> loads the populated table from that file, or writes
+// it there on the first run; keep one file per engine and per
+// --keys/--capacity/--prefill setting.
+template<typename Set>
+void prefillSet(Set& hashSet, const Workload& workload) {
+    using namespace benchmark_detail;
+    const std::vector<int>& prefill = workload.prefillKeys();
+    const char* snapshot = nullptr;
+    if constexpr (HasSnapshot<Set>::value) {
+        snapshot = std::getenv("CUCKOO_SNAPSHOT");
+        if (snapshot != nullptr && hashSet.load(snapshot)) return;
+    }
+
+    if constexpr (HasBulkLoad<Set>::value) {
+        hashSet.bulk_load(prefill.data(), prefill.data() + prefill.size());
+    } else {
+        for (int key : prefill) hashSet.add(key);
+    }
+
+    if constexpr (HasSnapshot<Set>::value) {
+        if (snapshot != nullptr && !hashSet.save(snapshot)) {
+            std::cerr << "Could not write snapshot " << snapshot << std::endl;
+        }
+    }
+}
+
+// Run the workload against a prefilled set and print the results
+template<typename Set>
+void runBenchmark(Set& hashSet, const BenchmarkArgs& args) {
+    using namespace benchmark_detail;
+    const Workload& workload = *args.workload;
+    int numOperations = args.operations;
+    int numThreads = args.threads;
+    int batchSize = args.batchSize;
+
+    int initialSize = hashSet.size();
+    int initialCapacity = hashSet.getCapacity();
+
+    std::vector<std::thread> threads;
+    std::vector<LatencyHistogram> latency(3 * numThreads);  // per thread and op type
+    std::atomic<int> successfulAdds(0);
+    std::atomic<int> successfulRemoves(0);
+
+    // Print header
+    std::cout << "- Running " << numOperations << " Operations w/ " << numThreads << " Threads -" << std::endl;
+
+    // Start timing
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Launch threads
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back([&, i]() {
+            Workload::Stream ops(workload, i, numThreads);
+            LatencyHistogram* hist = &latency[3 * i];
+
+            int localAdds = 0;
+            int localRemoves = 0;
+
+            // Operations are drawn a batch at a time, split by type and
+            // issued through the prefetching batch calls where there are any
+            std::vector<int> lookups, inserts, removals;
+            std::unique_ptr<bool[]> results(new bool[batchSize]);
+
+            for (int left = numOperations / numThreads; left > 0; left -= batchSize) {
+                lookups.clear();
+                inserts.clear();
+                removals.clear();
+                for (int j = 0; j < std::min(batchSize, left); j++) {
+                    Op op = ops.next();
+
+                    if (op.type == OpType::CONTAINS) {
+                        lookups.push_back(op.key);
+                    } else if (op.type == OpType::ADD) {
+                        inserts.push_back(op.key);
+                    } else {
+                        removals.push_back(op.key);
+                    }
+                }
+
+                // Each call is timed; only with a batch size of 1 is that
+                // one operation, since a batch's average hides its tail
+                uint64_t t0 = Ticks::now();
+                containsAll(hashSet, lookups.data(), lookups.size(), results.get());
+                uint64_t t1 = Ticks::now();
+                addAll(hashSet, inserts.data(), inserts.size(), results.get());
+                localAdds += std::count(results.get(), results.get() + inserts.size(), true);
+                uint64_t t2 = Ticks::now();
+                removeAll(hashSet, removals.data(), removals.size(), results.get());
+                localRemoves += std::count(results.get(), results.get() + removals.size(), true);
+                uint64_t t3 = Ticks::now();
+
+                if (batchSize == 1) {
+                    if (!lookups.empty()) hist[0].record(t1 - t0);
+                    if (!inserts.empty()) hist[1].record(t2 - t1);
+                    if (!removals.empty()) hist[2].record(t3 - t2);
+                }
+            }
+
+            successfulAdds.fetch_add(localAdds);
+            successfulRemoves.fetch_add(localRemoves);
+        });
+    }
+
+    // Wait for threads
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // End timing
+    auto end = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+
+    // Calculate results
+    int finalSize = hashSet.size();
+    int finalCapacity = hashSet.getCapacity();
+    int expectedSize = initialSize + successfulAdds.load() - successfulRemoves.load();
+
+    // Print results
+    std::cout << "Total time: " << duration.count() << std::endl;
+    std::cout << "Average time per operation: " << (double)duration.count() / numOperations << std::endl;
+    std::cout << "Hashset initial size: " << initialSize << std::endl;
+    std::cout << "Hashset initial capacity: " << initialCapacity << std::endl;
+    std::cout << "Expected size: " << expectedSize << std::endl;
+    std::cout << "Final hashset size: " << finalSize << std::endl;
+    std::cout << "Final hashset capacity: " << finalCapacity << std::endl;
+    std::cout << "Load factor: " << (double)finalSize / finalCapacity << std::endl;
+    std::cout << "Memory per key (bytes): " << (double)hashSet.memoryBytes() / finalSize << std::endl;
+    std::cout << "Engine: " << args.engine << std::endl;
+    std::cout << "Workload: " << workload.describe() << std::endl;
+
+    // Latency,<op>,<count>,<p50>,<p99>,<p99.9>,<max>, in ns
+    const char* opNames[] = {"contains", "add", "remove"};
+    for (int op = 0; op < 3 && batchSize == 1; op++) {
+        LatencyHistogram merged;
+        for (int i = 0; i < numThreads; i++) merged.merge(latency[3 * i + op]);
+        std::cout << "Latency," << opNames[op] << "," << merged.count() << ","
+                  << (uint64_t)Ticks::nanos(merged.percentile(0.5)) << ","
+                  << (uint64_t)Ticks::nanos(merged.percentile(0.99)) << ","
+                  << (uint64_t)Ticks::nanos(merged.percentile(0.999)) << ","
+                  << (uint64_t)Ticks::nanos(merged.maximum()) << std::endl;
+    }
+
+    // Telemetry,<kick paths of 0..5+ hops>,<relocate failures>,<resizes>,
+    // <resize μs>,<re-seeds>,<re-seed μs>,<stash inserts>,<stash hits>,
+    // <lock waits>,<lock wait μs>
+    if constexpr (HasCounters<Set>::value) {
+        TableCounters c = hashSet.counters();
+        std::cout << "Telemetry";
+        for (uint64_t n : c.kickPaths) std::cout << "," << n;
+        std::cout << "," << c.relocateFailures << "," << c.resizes << "," << (uint64_t)(c.resizeNanos / 1000)
+                  << "," << c.reseeds << "," << (uint64_t)(c.reseedNanos / 1000) << "," << c.stashInserts
+                  << "," << c.stashHits << "," << c.lockWaits << "," << (uint64_t)(c.lockWaitNanos / 1000)
+                  << std::endl;
+    }
+}
@@ -0,0 +1,94 @@
+// Benchmark driver for our own sets, picked with --engine: the striped
+// cuckoo set (striped_cuckoo.h, the default), the lock-free cuckoo set
+// (lockfree_cuckoo.h), or, for comparison with other open addressing
+// schemes, hopscotch (hopscotch_set.h) and Robin Hood (robin_hood_set.h)
+// sets, per-core striped shards served by their own threads
+// (delegated_set.h), and as baselines (baseline_sets.h) std::unordered_set
+// behind one mutex or BASELINE_SHARDS of them, and TBB's concurrent set when
+// built with -DWITH_TBB. The harness (benchmark.h) prints the same output
+// block as the generated implementations so the timing scripts work, then
+// latency percentiles and table counters. The workload flags (workload.h)
+// default to the generated drivers' workload.
+#include <iostream>
+#include <exception>
+
+#include "baseline_sets.h"
+#include "benchmark.h"
+#include "delegated_set.h"
+#include "hopscotch_set.h"
+#include "lockfree_cuckoo.h"
+#include "robin_hood_set.h"
+#include "striped_cuckoo.h"
+
+// Table memory: -DHUGE_PAGES maps large arrays with huge pages, and
+// -DNUMA_INTERLEAVE also spreads them over the NUMA nodes
+#if defined(NUMA_INTERLEAVE)
+using TableAlloc = HugePageAlloc<true>;
+#elif defined(HUGE_PAGES)
+using TableAlloc = HugePageAlloc<false>;
+#else
+using TableAlloc = HeapAlloc;
+#endif
+
+// Hash functions, one table each: -DCUCKOO_TABLES=3 or 4 for d-ary cuckoo
+#ifndef CUCKOO_TABLES
+#define CUCKOO_TABLES 2
+#endif
+
+// Mutex-guarded shards of the sharded baseline: -DBASELINE_SHARDS=N, a power of two
+#ifndef BASELINE_SHARDS
+#define BASELINE_SHARDS 64
+#endif
+
+// Server threads, one shard each, of the delegated set: -DDELEGATED_SERVERS=N,
+// 0 for one per core
+#ifndef DELEGATED_SERVERS
+#define DELEGATED_SERVERS 0
+#endif
+
+#ifdef WITH_TBB
+static const char* ENGINES = "striped|lockfree|hopscotch|robinhood|delegated|locked|sharded|tbb";
+#else
+static const char* ENGINES = "striped|lockfree|hopscotch|robinhood|delegated|locked|sharded";
+#endif
+
+template<typename Set, typename... Options>
+void run(const BenchmarkArgs& args, Options... options) {
+    // Initialize with 1 million capacity unless --capacity says otherwise
+    Set hashSet(args.workload->capacity, options...);
+    prefillSet(hashSet, *args.workload);
+    runBenchmark(hashSet, args);
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchmarkArgs args(argc, argv, "striped");
+        if (args.engine == "striped") {
+            run<StripedCuckooHashSet<int, 8, MurmurHash, TableAlloc, CUCKOO_TABLES>>(args);
+        } else if (args.engine == "lockfree") {
+            run<LockFreeCuckooHashSet<int, 8, MurmurHash, TableAlloc, CUCKOO_TABLES>>(args);
+        } else if (args.engine == "hopscotch") {
+            run<HopscotchHashSet<int, MurmurHash, TableAlloc>>(args);
+        } else if (args.engine == "robinhood") {
+            run<RobinHoodHashSet<int, MurmurHash, TableAlloc>>(args);
+        } else if (args.engine == "delegated") {
+            using Shard = StripedCuckooHashSet<int, 8, MurmurHash, TableAlloc, CUCKOO_TABLES>;
+            run<DelegatedHashSet<int, Shard>>(args, DELEGATED_SERVERS);
+        } else if (args.engine == "locked") {
+            run<LockedHashSet<int>>(args);
+        } else if (args.engine == "sharded") {
+            run<ShardedHashSet<int, BASELINE_SHARDS>>(args);
+#ifdef WITH_TBB
+        } else if (args.engine == "tbb") {
+            run<TbbHashSet<int>>(args);
+#endif
+        } else {
+            throw std::invalid_argument("unknown engine " + args.engine);
+        }
+    } catch (const std::invalid_argument& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        std::cerr << "Usage: " << BenchmarkArgs::usage(argv[0], ENGINES) << std::endl;
+        return 1;
+    }
+    return 0;
+}
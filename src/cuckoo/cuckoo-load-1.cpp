@@ -0,0 +1,43 @@
+// Achievable load factor and memory per key of our cuckoo set for 2-, 3- and
+// 4-ary tables (striped_cuckoo.h). Each configuration is filled with random
+// keys until it first has to grow; the load at that point is the most it can
+// hold, and the memory per key is what a table provisioned for that load
+// costs. Prints CSV, e.g. ./cuckoo-load-1 > results/cuckoo/load-factor.csv
+#include <iostream>
+#include <random>
+#include <climits>
+#include <cstdlib>
+
+#include "striped_cuckoo.h"
+
+template<int SLOTS, int TABLES>
+void fill(int initialCapacity) {
+    StripedCuckooHashSet<int, SLOTS, MurmurHash, HeapAlloc, TABLES> hashSet(initialCapacity);
+    std::mt19937 gen(714);  // Fixed seed
+    std::uniform_int_distribution<> dis(1, INT_MAX);
+
+    int capacity = hashSet.getCapacity();
+    int keys = 0;
+    size_t bytes = hashSet.memoryBytes();
+    while (hashSet.getCapacity() == capacity) {
+        keys = hashSet.size();
+        bytes = hashSet.memoryBytes();
+        hashSet.add(dis(gen));
+    }
+
+    std::cout << TABLES << "," << SLOTS << "," << keys << "," << capacity << ","
+              << (double)keys / capacity << "," << (double)bytes / keys << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int initialCapacity = (argc == 2) ? std::atoi(argv[1]) : 1000000;
+
+    std::cout << "Tables,Slots,Keys,Capacity,LoadFactor,BytesPerKey" << std::endl;
+    fill<8, 2>(initialCapacity);
+    fill<8, 3>(initialCapacity);
+    fill<8, 4>(initialCapacity);
+    fill<4, 2>(initialCapacity);
+    fill<4, 3>(initialCapacity);
+    fill<4, 4>(initialCapacity);
+    return 0;
+}
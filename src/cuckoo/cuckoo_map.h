@@ -0,0 +1,77 @@
+// Concurrent cuckoo hash map on the striped cuckoo engine (striped_cuckoo.h).
+//
+// Values of up to 8 trivially copyable bytes sit inline in the table: find()
+// reads them without locking, and upsert()/update_fn() modify them in place
+// under the key's stripes instead of removing and re-adding the key. Larger
+// values are allocated once per key and reached through the slot, so
+// relocations and resizes only move a pointer.
+#pragma once
+
+#include "striped_cuckoo.h"
+
+template<typename K, typename V, int SLOTS = 8, typename Hash = MurmurHash, typename Alloc = HeapAlloc,
+         int TABLES = 2>
+class CuckooHashMap : public StripedCuckooTable<K, V, SLOTS, Hash, Alloc, TABLES> {
+private:
+    using Base = StripedCuckooTable<K, V, SLOTS, Hash, Alloc, TABLES>;
+    using Cell = typename Base::Cell;
+    static constexpr bool INLINE = ValueTraits<V>::inlined;
+
+    static V get(const Cell& c) {
+        if constexpr (INLINE) return c.load(std::memory_order_relaxed);
+        else return *c.load(std::memory_order_relaxed);
+    }
+
+    static void put(Cell& c, const V& value) {
+        if constexpr (INLINE) c.store(value, std::memory_order_relaxed);
+        else c.store(new V(value), std::memory_order_relaxed);
+    }
+
+    // fn(V&) on the stored value; the caller holds the key's stripes
+    template<typename Fn>
+    static void apply(Cell& c, Fn& fn) {
+        if constexpr (INLINE) {
+            V value = c.load(std::memory_order_relaxed);
+            fn(value);
+            c.store(value, std::memory_order_relaxed);
+        } else {
+            fn(*c.load(std::memory_order_relaxed));
+        }
+    }
+
+public:
+    // initialCapacity is the number of keys the tables can hold
+    explicit CuckooHashMap(int initialCapacity, uint64_t seed = 714) : Base(initialCapacity, seed) {}
+
+    // Copy key's value into out; out is unspecified if false is returned
+    bool find(K key, V& out) const {
+        return this->probe(key, [&out](const Cell& c) { out = get(c); });
+    }
+
+    bool contains(K key) const {
+        return this->probe(key, nullptr);
+    }
+
+    // Insert key -> value unless key is present
+    bool insert(K key, const V& value) {
+        return this->insertOrVisit(key, nullptr, [&value](Cell& c) { put(c, value); });
+    }
+
+    // If key is present run fn(V&) on its value in place, otherwise insert
+    // key -> value. Returns true if key was inserted.
+    template<typename Fn>
+    bool upsert(K key, Fn fn, const V& value) {
+        return this->insertOrVisit(key, [&fn](Cell& c) { apply(c, fn); },
+                                   [&value](Cell& c) { put(c, value); });
+    }
+
+    // Run fn(V&) on key's value in place; false if key is absent
+    template<typename Fn>
+    bool update_fn(K key, Fn fn) {
+        return this->modify(key, [&fn](Cell& c) { apply(c, fn); });
+    }
+
+    bool erase(K key) {
+        return Base::erase(key);
+    }
+};
@@ -0,0 +1,294 @@
+// Delegated cuckoo set: the key space is split over one shard per server
+// thread, a StripedCuckooHashSet (striped_cuckoo.h) that only its server
+// ever operates on, so each shard stays in one core's cache and its stripes
+// are never contended. It has the interface of StripedCuckooHashSet, so the
+// cuckoo driver runs it on the same worker loop as the shared table.
+//
+// Clients look keys up, add and remove them only through the servers. A
+// batch call sorts its keys by shard and posts one request per shard it
+// touches, naming the keys and where the results go, to that shard's request
+// ring: a bounded multi-producer, single-consumer queue (Vyukov's, with a
+// sequence number per cell) that producers claim cells of with one CAS on
+// its tail. The server takes requests in order, applies them with the
+// shard's prefetching batch calls, and counts down the request's completion
+// slot, a counter on the client's stack that the client spins on until every
+// shard it posted to has answered. A single add, remove or contains is a
+// batch of one, so clients should use the batch calls.
+//
+// Servers are pinned one to a core on Linux. The shard of a key comes from a
+// hash policy seeded apart from the shards' own, so the keys of a shard are
+// still spread over its buckets. Size, capacity, memory and counters are
+// read from the shards directly, which are safe to read from any thread.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "hash_policy.h"
+#include "striped_cuckoo.h"
+#include "telemetry.h"
+#include "version_lock.h"
+
+template<typename T, typename Shard = StripedCuckooHashSet<T>, typename Hash = MurmurHash>
+class DelegatedHashSet {
+    static const size_t RING = 1024;  // requests a shard's ring holds, power of two
+
+    enum Op { CONTAINS, ADD, REMOVE };
+
+    // Keys of one batch call that fall in one shard
+    struct Request {
+        Op op;
+        uint32_t n;
+        const T* keys;
+        bool* results;
+        std::atomic<int>* pending;  // completion slot, counted down once done
+    };
+
+    // Bounded MPSC queue. Cell i is free for the producer that claims
+    // position p when its sequence is p, and full once it is p + 1.
+    class RequestRing {
+    public:
+        RequestRing() : cells(new Cell[RING]) {
+            for (size_t i = 0; i < RING; i++) cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        void push(const Request& r) {
+            uint64_t pos = tail.load(std::memory_order_relaxed);
+            int spins = 0;
+            while (true) {
+                Cell& c = cells[pos & (RING - 1)];
+                uint64_t seq = c.seq.load(std::memory_order_acquire);
+                if (seq == pos) {
+                    if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        c.req = r;
+                        c.seq.store(pos + 1, std::memory_order_release);
+                        return;
+                    }
+                } else {
+                    if (seq < pos) spinWait(spins);  // full: the server is a lap behind
+                    pos = tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Server only
+        bool pop(Request& r) {
+            Cell& c = cells[head & (RING - 1)];
+            if (c.seq.load(std::memory_order_acquire) != head + 1) return false;
+            r = c.req;
+            c.seq.store(head + RING, std::memory_order_release);
+            head++;
+            return true;
+        }
+
+        static size_t bytes() {
+            return RING * sizeof(Cell);
+        }
+
+    private:
+        struct alignas(64) Cell {
+            std::atomic<uint64_t> seq;
+            Request req;
+        };
+
+        std::unique_ptr<Cell[]> cells;
+        alignas(64) std::atomic<uint64_t> tail{0};  // shared by the clients
+        alignas(64) uint64_t head = 0;              // the server's own
+    };
+
+    struct alignas(64) Server {
+        Server(int capacity, uint64_t seed) : set(capacity, seed) {}
+
+        Shard set;
+        RequestRing ring;
+        std::thread thread;
+    };
+
+    // A client's batch sorted by shard, reused across its calls
+    struct Scratch {
+        std::vector<T> keys;
+        std::unique_ptr<bool[]> results;
+        std::vector<uint32_t> slot;   // where each key of the batch went
+        std::vector<uint32_t> first;  // per shard, then its fill position
+        size_t room = 0;
+    };
+
+public:
+    // One server per core unless servers says otherwise
+    DelegatedHashSet(int initialCapacity, int servers = 0, uint64_t seed = 714) : route(~seed) {
+        int cores = std::max(1u, std::thread::hardware_concurrency());
+        if (servers <= 0) servers = cores;
+        for (int i = 0; i < servers; i++) {
+            shards.emplace_back(new Server(initialCapacity / servers + 1, seed));
+        }
+        for (int i = 0; i < servers; i++) {
+            Server& s = *shards[i];
+            s.thread = std::thread([this, &s] { serve(s); });
+#ifdef __linux__
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(i % cores, &cpus);
+            pthread_setaffinity_np(s.thread.native_handle(), sizeof(cpus), &cpus);
+#endif
+        }
+    }
+
+    DelegatedHashSet(const DelegatedHashSet&) = delete;
+    DelegatedHashSet& operator=(const DelegatedHashSet&) = delete;
+
+    ~DelegatedHashSet() {
+        stop.store(true, std::memory_order_release);
+        for (auto& s : shards) s->thread.join();
+    }
+
+    bool add(T x) {
+        bool added;
+        add_batch(&x, 1, &added);
+        return added;
+    }
+
+    bool remove(T x) {
+        bool removed;
+        remove_batch(&x, 1, &removed);
+        return removed;
+    }
+
+    bool contains(T x) {
+        bool found;
+        contains_batch(&x, 1, &found);
+        return found;
+    }
+
+    void contains_batch(const T* keys, size_t n, bool* out) {
+        delegate(CONTAINS, keys, n, out);
+    }
+
+    void add_batch(const T* keys, size_t n, bool* out) {
+        delegate(ADD, keys, n, out);
+    }
+
+    void remove_batch(const T* keys, size_t n, bool* out) {
+        delegate(REMOVE, keys, n, out);
+    }
+
+    // Splits the keys by shard and loads each shard directly; not for use
+    // while other threads are adding or removing
+    template<typename It>
+    void bulk_load(It first, It last) {
+        std::vector<std::vector<T>> parts(shards.size());
+        for (It it = first; it != last; ++it) parts[shardOf(*it)].push_back(*it);
+        for (size_t i = 0; i < shards.size(); i++) {
+            shards[i]->set.bulk_load(parts[i].begin(), parts[i].end());
+        }
+    }
+
+    int size() const {
+        int n = 0;
+        for (auto& s : shards) n += s->set.size();
+        return n;
+    }
+
+    int getCapacity() const {
+        int n = 0;
+        for (auto& s : shards) n += s->set.getCapacity();
+        return n;
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = sizeof(*this);
+        for (auto& s : shards) bytes += sizeof(Server) - sizeof(Shard) + s->set.memoryBytes() + RequestRing::bytes();
+        return bytes;
+    }
+
+    // Counters of every shard, summed
+    TableCounters counters() const {
+        TableCounters c;
+        for (auto& s : shards) c += s->set.counters();
+        return c;
+    }
+
+private:
+    size_t shardOf(T x) const {
+        return (route(x, 0) >> 32) * shards.size() >> 32;
+    }
+
+    // Post the keys of each shard as one request and wait for all of them
+    void delegate(Op op, const T* keys, size_t n, bool* out) {
+        if (n == 0) return;
+        static thread_local Scratch scratch;
+        Scratch& s = scratch;
+        size_t servers = shards.size();
+        if (s.room < n) {
+            s.keys.resize(n);
+            s.results.reset(new bool[n]);
+            s.slot.resize(n);
+            s.room = n;
+        }
+        s.first.assign(servers + 1, 0);
+
+        // Counting sort by shard: count, offsets, then place
+        for (size_t i = 0; i < n; i++) {
+            s.slot[i] = shardOf(keys[i]);
+            s.first[s.slot[i] + 1]++;
+        }
+        int touched = 0;
+        for (size_t i = 0; i < servers; i++) {
+            touched += s.first[i + 1] != 0;
+            s.first[i + 1] += s.first[i];
+        }
+        std::atomic<int> pending(touched);
+        for (size_t i = 0; i < n; i++) {
+            uint32_t at = s.first[s.slot[i]]++;
+            s.keys[at] = keys[i];
+            s.slot[i] = at;
+        }
+
+        // Each shard's keys now end at its fill position
+        uint32_t begin = 0;
+        for (size_t i = 0; i < servers; i++) {
+            uint32_t end = s.first[i];
+            if (end != begin) {
+                shards[i]->ring.push(Request{op, end - begin, &s.keys[begin], &s.results[begin], &pending});
+            }
+            begin = end;
+        }
+
+        int spins = 0;
+        while (pending.load(std::memory_order_acquire) != 0) spinWait(spins);
+        for (size_t i = 0; i < n; i++) out[i] = s.results[s.slot[i]];
+    }
+
+    // Apply the shard's requests until told to stop and its ring is empty
+    void serve(Server& s) {
+        Request r;
+        int spins = 0;
+        while (true) {
+            if (!s.ring.pop(r)) {
+                if (stop.load(std::memory_order_acquire)) return;  // no client is left
+                spinWait(spins);
+                continue;
+            }
+            spins = 0;
+            if (r.op == CONTAINS) {
+                s.set.contains_batch(r.keys, r.n, r.results);
+            } else if (r.op == ADD) {
+                s.set.add_batch(r.keys, r.n, r.results);
+            } else {
+                s.set.remove_batch(r.keys, r.n, r.results);
+            }
+            r.pending->fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    Hash route;
+    std::vector<std::unique_ptr<Server>> shards;
+    std::atomic<bool> stop{false};
+};
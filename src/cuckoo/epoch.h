@@ -0,0 +1,229 @@
+// Epoch-based reclamation for replaced table generations and stripe arrays.
+//
+// A resize or re-seed replaces a table generation or stripe array while
+// lock-free readers may still be probing the old one, so the old object can
+// only be freed once nobody can hold a pointer to it. Every operation pins
+// the current epoch for as long as it uses such pointers; retiring an object
+// stamps it with the epoch and advances the epoch. An object is freed once
+// every pinned thread has pinned a later epoch, which it could only have
+// done after the object was unlinked. Pinning is a store to the thread's own
+// slot, so a pin never waits for, or writes to, anything shared.
+//
+// The store must be ordered before the reader's next loads, which normally
+// takes a full fence on every pin. On Linux the reclaimer instead issues
+// membarrier(), which runs a full fence on every thread of the process, so
+// pinning only needs a compiler fence. Retired objects are reclaimed by the
+// outermost unpin of whichever thread first finds none of the visible pins
+// old enough to hold them, so a resize's old generation goes as soon as its
+// last reader leaves, and the expensive side only follows a resize.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#ifdef __linux__
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Small ids for the live threads; an id is reused once its thread exits
+class ThreadIds {
+public:
+    static const int MAX = 256;
+
+    static int get() {
+        static thread_local int id = -1;
+        if (__builtin_expect(id < 0, 0)) id = acquire();
+        return id;
+    }
+
+    // One past the largest id handed out so far
+    static int limit() {
+        return highWater().load(std::memory_order_acquire);
+    }
+
+private:
+    struct Owner {
+        int id = -1;
+        ~Owner() {
+            if (id < 0) return;
+            std::lock_guard<std::mutex> lk(lock());
+            used()[id] = false;
+        }
+    };
+
+    static int acquire() {
+        static thread_local Owner owner;
+        std::lock_guard<std::mutex> lk(lock());
+        std::vector<bool>& u = used();
+        int id = std::find(u.begin(), u.end(), false) - u.begin();
+        if (id == MAX) throw std::length_error("more than ThreadIds::MAX live threads");
+        u[id] = true;
+        if (id >= highWater().load(std::memory_order_relaxed)) highWater().store(id + 1, std::memory_order_release);
+        owner.id = id;
+        return id;
+    }
+
+    static std::mutex& lock() {
+        static std::mutex m;
+        return m;
+    }
+
+    static std::vector<bool>& used() {
+        static std::vector<bool> u(MAX, false);
+        return u;
+    }
+
+    static std::atomic<int>& highWater() {
+        static std::atomic<int> n{0};
+        return n;
+    }
+};
+
+// Fence pair where light() is cheap and heavy() makes every light() in the
+// process act as a full fence; both are full fences without membarrier.
+// AVAILABLE is set during static initialization and only ever goes from
+// false to true, so a light() that ran before then was a full fence anyway.
+class AsymmetricFence {
+public:
+    static void light() {
+        if (__builtin_expect(AVAILABLE, 1)) {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        } else {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    static void heavy() {
+#ifdef __linux__
+        if (AVAILABLE) {
+            syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+            return;
+        }
+#endif
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+private:
+    static bool enable() {
+#ifdef __linux__
+        return syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+#else
+        return false;
+#endif
+    }
+
+    static inline const bool AVAILABLE = enable();
+};
+
+class EpochDomain {
+    static const uint64_t IDLE = UINT64_MAX;
+
+    // The epoch a thread pinned, IDLE when it holds no pointers. depth is
+    // only touched by the owning thread and lets pins nest.
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{IDLE};
+        int depth = 0;
+    };
+
+public:
+    class Guard {
+    public:
+        Guard(EpochDomain& d, Slot& s) : domain(&d), slot(&s) {}
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        // The outermost unpin frees what it was the last to hold
+        ~Guard() {
+            if (--slot->depth != 0) return;
+            slot->epoch.store(IDLE, std::memory_order_release);
+            if (domain->oldestRetired.load(std::memory_order_relaxed) != IDLE) domain->collect();
+        }
+
+    private:
+        EpochDomain* domain;
+        Slot* slot;
+    };
+
+    EpochDomain() = default;
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Frees whatever is still retired; nothing may be pinned any more
+    ~EpochDomain() {
+        for (const Retired& r : limbo) r.free(r.p);
+    }
+
+    // Keep everything reachable now alive until the guard goes away. The
+    // acquire load pairs with retire(): a thread that sees the advanced epoch
+    // also sees the unlink that preceded it.
+    Guard pin() {
+        Slot& s = slots[ThreadIds::get()];
+        if (s.depth++ == 0) {
+            s.epoch.store(global.load(std::memory_order_acquire), std::memory_order_relaxed);
+            AsymmetricFence::light();
+        }
+        return Guard(*this, s);
+    }
+
+    // Free p, already unlinked, once no pinned thread can still see it
+    template<typename U>
+    void retire(U* p) {
+        std::lock_guard<std::mutex> lk(lock);
+        limbo.push_back({p, [](void* q) { delete static_cast<U*>(q); }, global.fetch_add(1)});
+        if (limbo.size() == 1) oldestRetired.store(limbo[0].epoch, std::memory_order_relaxed);
+    }
+
+    // Free every retired object older than the oldest pinned epoch
+    void reclaim() {
+        AsymmetricFence::heavy();
+        uint64_t oldest = IDLE;
+        for (int i = 0; i < ThreadIds::limit(); i++) {
+            oldest = std::min(oldest, slots[i].epoch.load(std::memory_order_acquire));
+        }
+
+        std::vector<Retired> done;
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            auto keep = std::partition(limbo.begin(), limbo.end(),
+                                       [oldest](const Retired& r) { return r.epoch >= oldest; });
+            done.assign(keep, limbo.end());
+            limbo.erase(keep, limbo.end());
+            uint64_t next = IDLE;
+            for (const Retired& r : limbo) next = std::min(next, r.epoch);
+            oldestRetired.store(next, std::memory_order_relaxed);
+        }
+        for (const Retired& r : done) r.free(r.p);
+    }
+
+private:
+    // Reclaim unless another thread is at it or a visible pin still holds
+    // the oldest retired object; only then is the heavy fence worth paying
+    void collect() {
+        if (reclaiming.exchange(true, std::memory_order_acquire)) return;
+        uint64_t retired = oldestRetired.load(std::memory_order_relaxed);
+        bool held = false;
+        for (int i = 0; i < ThreadIds::limit() && !held; i++) {
+            held = slots[i].epoch.load(std::memory_order_relaxed) <= retired;
+        }
+        if (!held) reclaim();
+        reclaiming.store(false, std::memory_order_release);
+    }
+
+    struct Retired {
+        void* p;
+        void (*free)(void*);
+        uint64_t epoch;  // the epoch it was retired in
+    };
+
+    std::atomic<uint64_t> global{0};
+    Slot slots[ThreadIds::MAX];
+    std::mutex lock;
+    std::vector<Retired> limbo;
+    std::atomic<uint64_t> oldestRetired{IDLE};  // epoch of the oldest in limbo, IDLE if none
+    std::atomic<bool> reclaiming{false};
+};
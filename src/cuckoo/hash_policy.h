@@ -0,0 +1,111 @@
+// Seedable hash policies for the striped cuckoo table (striped_cuckoo.h).
+//
+// A policy is built from a 64-bit seed and maps an integer key to one of
+// FUNCTIONS independent 64-bit hashes, one per table of a d-ary table (up to
+// four). Later functions' keys are drawn after earlier ones', so adding
+// functions leaves the first ones unchanged. The table takes bucket and stripe
+// indices from the low bits and tags from bits 32-39, so every bit of the
+// result has to be well mixed; std::hash<int> (the identity on libstdc++)
+// is not.
+#pragma once
+
+#include <cstdint>
+
+// splitmix64 step; derives per-function keys and the next seed for a rehash
+static inline uint64_t mixSeed(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Multiply by a random odd 64-bit constant and fold the two halves of the
+// 128-bit product together, so the low bits depend on every key bit
+class MultiplyShiftHash {
+public:
+    static const int FUNCTIONS = 4;
+
+    explicit MultiplyShiftHash(uint64_t seed) : seed_(seed) {
+        uint64_t s = seed;
+        for (int i = 0; i < FUNCTIONS; i++) {
+            s = mixSeed(s);
+            mult[i] = s | 1;
+            s = mixSeed(s);
+            add[i] = s;
+        }
+    }
+
+    uint64_t operator()(uint64_t x, int which) const {
+        unsigned __int128 p = (unsigned __int128)(x + add[which]) * mult[which];
+        return (uint64_t)p ^ (uint64_t)(p >> 64);
+    }
+
+    uint64_t seed() const { return seed_; }
+
+private:
+    uint64_t seed_;
+    uint64_t mult[FUNCTIONS];
+    uint64_t add[FUNCTIONS];
+};
+
+// MurmurHash3's 64-bit finalizer over the key xor a per-function key
+class MurmurHash {
+public:
+    static const int FUNCTIONS = 4;
+
+    explicit MurmurHash(uint64_t seed) : seed_(seed) {
+        uint64_t s = seed;
+        for (int i = 0; i < FUNCTIONS; i++) {
+            s = mixSeed(s);
+            key[i] = s;
+        }
+    }
+
+    uint64_t operator()(uint64_t x, int which) const {
+        x ^= key[which];
+        x = (x ^ (x >> 33)) * 0xff51afd7ed558ccdULL;
+        x = (x ^ (x >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+        return x ^ (x >> 33);
+    }
+
+    uint64_t seed() const { return seed_; }
+
+private:
+    uint64_t seed_;
+    uint64_t key[FUNCTIONS];
+};
+
+// Simple tabulation: xor of one random word per key byte. 3-independent, so
+// cuckoo insertion behaves as with truly random hashing, at the cost of
+// 2 KiB of tables per function and key byte, and KEY_BYTES lookups per hash.
+template<int KEY_BYTES = 4>
+class TabulationHash {
+public:
+    static const int FUNCTIONS = 4;
+
+    explicit TabulationHash(uint64_t seed) : seed_(seed) {
+        uint64_t s = seed;
+        for (int i = 0; i < FUNCTIONS; i++) {
+            for (int j = 0; j < KEY_BYTES; j++) {
+                for (int k = 0; k < 256; k++) {
+                    s = mixSeed(s);
+                    table[i][j][k] = s;
+                }
+            }
+        }
+    }
+
+    uint64_t operator()(uint64_t x, int which) const {
+        uint64_t h = 0;
+        for (int j = 0; j < KEY_BYTES; j++) {
+            h ^= table[which][j][(x >> (8 * j)) & 0xff];
+        }
+        return h;
+    }
+
+    uint64_t seed() const { return seed_; }
+
+private:
+    uint64_t seed_;
+    uint64_t table[FUNCTIONS][KEY_BYTES][256];
+};
@@ -0,0 +1,338 @@
+// Concurrent hopscotch hash set (Herlihy, Shavit and Tzafrir, "Hopscotch
+// Hashing", DISC 2008) with the interface of StripedCuckooHashSet, so the
+// cuckoo driver can compare it against cuckoo hashing on one harness.
+//
+// Every key lives within H slots of its home bucket, and each bucket keeps a
+// bitmap of which of those H slots hold keys homed there, so a lookup reads
+// one bitmap and the few slots it names, usually on one cache line. An insert
+// takes the first free slot within ADD_RANGE of its home; while that slot is
+// outside the neighborhood, a key closer to home whose own neighborhood
+// covers the free slot hops into it, moving the hole back toward home. The
+// slot array runs ADD_RANGE past the last home bucket instead of wrapping
+// around, so every range an operation touches is contiguous.
+//
+// Locks cover SEGMENT consecutive slots each (VersionLock, version_lock.h).
+// A writer locks the segments of the range it may change in increasing
+// order: the neighborhood, or the whole add range if the insert must hop.
+// Lookups never lock: they read the neighborhood and retry if one of its
+// segments changed meanwhile. When an insert can hop no free slot home, the
+// table doubles: the resizing thread takes every segment, rehashes into a new
+// generation and publishes it, and the old one is freed through epochs
+// (epoch.h) once no operation can still see it.
+//
+// Keys are integers and 0 is reserved as the empty slot.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include "epoch.h"
+#include "hash_policy.h"
+#include "table_alloc.h"
+#include "table_common.h"
+#include "telemetry.h"
+#include "version_lock.h"
+
+template<typename T, typename Hash = MurmurHash, typename Alloc = HeapAlloc>
+class HopscotchHashSet {
+    static const int H = 32;           // neighborhood, one bit each in a bucket's hop bitmap
+    static const int ADD_RANGE = 512;  // how far from home an insert looks for a free slot
+    static const int SEGMENT = 256;    // slots per lock
+    static const int PREFETCH_WINDOW = 16;  // keys whose buckets a batch call loads at once
+    static const T EMPTY = 0;
+
+    static_assert(H <= 32 && H <= ADD_RANGE, "the hop bitmap is one 32-bit word");
+
+    struct Bucket {
+        std::atomic<uint32_t> hop{0};  // bit i: slot (this + i) holds a key homed here
+        std::atomic<T> key{EMPTY};
+    };
+
+    struct alignas(64) Segment {
+        VersionLock lock;
+    };
+
+    struct Table {
+        int capacity;  // home buckets, power of two
+        int slots;     // capacity + ADD_RANGE
+        int segments;
+        Hash hash;
+        Bucket* bucket;
+        Segment* segment;
+
+        Table(int capacity, const Hash& hash)
+            : capacity(capacity), slots(capacity + ADD_RANGE),
+              segments((slots + SEGMENT - 1) / SEGMENT), hash(hash) {
+            bucket = Alloc::template allocate<Bucket>(slots);
+            segment = Alloc::template allocate<Segment>(segments);
+        }
+
+        ~Table() {
+            Alloc::deallocate(bucket, slots);
+            Alloc::deallocate(segment, segments);
+        }
+    };
+
+    enum Result { INSERTED, PRESENT, FULL };
+
+    std::atomic<Table*> table;
+    mutable EpochDomain epochs;  // frees replaced generations
+    TableTelemetry telemetry;
+
+    KeyCounter counts;
+
+    static int home(const Table* t, T x) {
+        return t->hash(x, 0) & (t->capacity - 1);
+    }
+
+    // Slot of x in the neighborhood of its home h, or -1
+    static int find(const Table* t, int h, T x) {
+        for (uint32_t hop = t->bucket[h].hop.load(std::memory_order_relaxed); hop != 0; hop &= hop - 1) {
+            int i = h + __builtin_ctz(hop);
+            if (t->bucket[i].key.load(std::memory_order_relaxed) == x) return i;
+        }
+        return -1;
+    }
+
+    static void place(Table* t, int h, int i, T x) {
+        t->bucket[i].key.store(x, std::memory_order_relaxed);
+        Bucket& b = t->bucket[h];
+        b.hop.store(b.hop.load(std::memory_order_relaxed) | 1u << (i - h), std::memory_order_relaxed);
+    }
+
+    void lockSegment(VersionLock& l) const {
+        if (l.try_lock()) return;
+        uint64_t start = Ticks::now();
+        l.lock();
+        telemetry.add(TableTelemetry::LOCK_WAIT);
+        telemetry.add(TableTelemetry::LOCK_WAIT_TICKS, Ticks::now() - start);
+    }
+
+    // Lock the segments of slots [from, to] in order; false, with nothing
+    // held, if the table was replaced before we had them
+    bool lockRange(Table* t, int from, int to) {
+        for (int s = from / SEGMENT; s <= to / SEGMENT; s++) lockSegment(t->segment[s].lock);
+        if (table.load() == t) return true;
+        unlockRange(t, from, to, false);
+        return false;
+    }
+
+    static void unlockRange(Table* t, int from, int to, bool changed) {
+        for (int s = from / SEGMENT; s <= to / SEGMENT; s++) t->segment[s].lock.unlock(changed);
+    }
+
+    // Insert x, whose home is h, anywhere in its add range: take the first
+    // free slot and hop it back into the neighborhood. The caller holds the
+    // add range, or owns the table outright.
+    Result insertFar(Table* t, int h, T x) {
+        if (find(t, h, x) >= 0) return PRESENT;
+        int free = h;
+        while (free < h + ADD_RANGE && t->bucket[free].key.load(std::memory_order_relaxed) != EMPTY) free++;
+        if (free == h + ADD_RANGE) return FULL;
+
+        int hops = 0;
+        while (free - h >= H) {
+            // The earliest key that may move into the free slot moves the
+            // hole furthest; a failed search leaves a valid table behind
+            int moved = -1;
+            for (int b = free - H + 1; b < free && moved < 0; b++) {
+                uint32_t hop = t->bucket[b].hop.load(std::memory_order_relaxed);
+                int i = hop != 0 ? b + __builtin_ctz(hop) : free;
+                if (i >= free) continue;
+
+                t->bucket[free].key.store(t->bucket[i].key.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                t->bucket[b].hop.store((hop | 1u << (free - b)) & ~(1u << (i - b)), std::memory_order_relaxed);
+                t->bucket[i].key.store(EMPTY, std::memory_order_relaxed);
+                moved = i;
+            }
+            if (moved < 0) {
+                telemetry.add(TableTelemetry::RELOCATE_FAILURE);
+                return FULL;
+            }
+            free = moved;
+            hops++;
+        }
+        place(t, h, free, x);
+        telemetry.kickPath(hops);
+        return INSERTED;
+    }
+
+    // Replace t by a table twice the size, unless that already happened.
+    // Taking every segment in order waits out the writers of t and, since
+    // it bumps every version, sends its readers to the new table. Returns
+    // false if the table cannot grow.
+    bool resize(Table* t) {
+        uint64_t start = Ticks::now();
+        for (int s = 0; s < t->segments; s++) lockSegment(t->segment[s].lock);
+        if (table.load() != t) {
+            for (int s = 0; s < t->segments; s++) t->segment[s].lock.unlock(false);
+            return true;
+        }
+
+        Table* n = nullptr;
+        for (int capacity = t->capacity; n == nullptr;) {
+            if (capacity > INT_MAX / 2 - ADD_RANGE) {
+                for (int s = 0; s < t->segments; s++) t->segment[s].lock.unlock(false);
+                return false;
+            }
+            capacity *= 2;
+            n = new Table(capacity, t->hash);
+            for (int i = 0; i < t->slots && n != nullptr; i++) {
+                T x = t->bucket[i].key.load(std::memory_order_relaxed);
+                if (x != EMPTY && insertFar(n, home(n, x), x) == FULL) {
+                    delete n;
+                    n = nullptr;
+                }
+            }
+        }
+
+        table.store(n, std::memory_order_release);
+        for (int s = 0; s < t->segments; s++) t->segment[s].lock.unlock(true);
+        epochs.retire(t);  // lock-free readers may still be probing it
+        telemetry.add(TableTelemetry::RESIZE);
+        telemetry.add(TableTelemetry::RESIZE_TICKS, Ticks::now() - start);
+        return true;
+    }
+
+    // A batch call, prefetching the home bucket (bitmap and first slot)
+    // of each key
+    template<typename Op>
+    void batch(const T* keys, size_t n, bool* out, Op op) {
+        prefetchedBatch<PREFETCH_WINDOW>(epochs, keys, n, out, [this](const T* first, const T* last) {
+            const Table* t = table.load(std::memory_order_acquire);
+            for (; first != last; ++first) __builtin_prefetch(&t->bucket[home(t, *first)]);
+        }, op);
+    }
+
+public:
+    HopscotchHashSet(int initialCapacity, uint64_t seed = 714) {
+        table.store(new Table(roundUpPow2(initialCapacity), Hash(seed)));
+    }
+
+    HopscotchHashSet(const HopscotchHashSet&) = delete;
+    HopscotchHashSet& operator=(const HopscotchHashSet&) = delete;
+
+    ~HopscotchHashSet() {
+        delete table.load();
+    }
+
+    bool add(T x) {
+        if (x == EMPTY) return false;
+        auto pinned = epochs.pin();
+        while (true) {
+            Table* t = table.load();
+            int h = home(t, x);
+
+            // Most inserts find room in the neighborhood; only those that
+            // must hop lock the whole add range
+            int to = h + H - 1;
+            if (!lockRange(t, h, to)) continue;
+            if (find(t, h, x) >= 0) {
+                unlockRange(t, h, to, false);
+                return false;
+            }
+            for (int i = h; i <= to; i++) {
+                if (t->bucket[i].key.load(std::memory_order_relaxed) == EMPTY) {
+                    place(t, h, i, x);
+                    unlockRange(t, h, to, true);
+                    counts.add(1);
+                    return true;
+                }
+            }
+            unlockRange(t, h, to, false);
+
+            to = h + ADD_RANGE - 1;
+            if (!lockRange(t, h, to)) continue;
+            Result r = insertFar(t, h, x);
+            unlockRange(t, h, to, r != PRESENT);
+            if (r == INSERTED) counts.add(1);
+            if (r != FULL) return r == INSERTED;
+            if (!resize(t)) return false;
+        }
+    }
+
+    bool remove(T x) {
+        if (x == EMPTY) return false;
+        auto pinned = epochs.pin();
+        while (true) {
+            Table* t = table.load();
+            int h = home(t, x);
+            if (!lockRange(t, h, h + H - 1)) continue;
+            int i = find(t, h, x);
+            if (i >= 0) {
+                t->bucket[i].key.store(EMPTY, std::memory_order_relaxed);
+                Bucket& b = t->bucket[h];
+                b.hop.store(b.hop.load(std::memory_order_relaxed) & ~(1u << (i - h)), std::memory_order_relaxed);
+                counts.add(-1);
+            }
+            unlockRange(t, h, h + H - 1, i >= 0);
+            return i >= 0;
+        }
+    }
+
+    bool contains(T x) const {
+        if (x == EMPTY) return false;
+        auto pinned = epochs.pin();
+        while (true) {
+            const Table* t = table.load(std::memory_order_acquire);
+            int h = home(t, x);
+            const VersionLock& first = t->segment[h / SEGMENT].lock;
+            const VersionLock& last = t->segment[(h + H - 1) / SEGMENT].lock;
+            unsigned v1 = first.read();
+            unsigned v2 = last.read();
+            if (VersionLock::locked(v1 | v2)) {
+                cpuRelax();
+                continue;
+            }
+            bool found = find(t, h, x) >= 0;
+            if (first.validate(v1) && last.validate(v2)) return found;
+        }
+    }
+
+    // Batched forms: out[i] receives the result for keys[i]. Lookups for a
+    // window of keys are prefetched together to hide DRAM latency.
+    void contains_batch(const T* keys, size_t n, bool* out) {
+        batch(keys, n, out, [this](T x) { return contains(x); });
+    }
+
+    void add_batch(const T* keys, size_t n, bool* out) {
+        batch(keys, n, out, [this](T x) { return add(x); });
+    }
+
+    void remove_batch(const T* keys, size_t n, bool* out) {
+        batch(keys, n, out, [this](T x) { return remove(x); });
+    }
+
+    // Insert [first, last); here simply one add after another
+    template<typename It>
+    void bulk_load(It first, It last) {
+        for (; first != last; ++first) add(*first);
+    }
+
+    // Number of keys; exact when no writer is running
+    int size() const {
+        return counts.total();
+    }
+
+    // Number of home buckets, one key each
+    int getCapacity() const {
+        auto pinned = epochs.pin();
+        return table.load()->capacity;
+    }
+
+    // Bytes held by the set and its table
+    size_t memoryBytes() const {
+        auto pinned = epochs.pin();
+        const Table* t = table.load();
+        return sizeof(*this) + sizeof(Table) + (size_t)t->slots * sizeof(Bucket) +
+               (size_t)t->segments * sizeof(Segment);
+    }
+
+    // Hops, failed hop searches, resizes and lock waits so far, summed over
+    // threads
+    TableCounters counters() const {
+        return telemetry.totals();
+    }
+};
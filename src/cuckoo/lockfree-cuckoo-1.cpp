@@ -0,0 +1,26 @@
+// The lock-free cuckoo set (lockfree_cuckoo.h) under the shared benchmark
+// harness, named so run_timing_cuckoo.sh can time it next to the generated
+// implementations: ./run_timing_cuckoo.sh lockfree 1. Same as
+// cuckoo-custom-1 with --engine=lockfree.
+#include <iostream>
+#include <exception>
+
+#include "benchmark.h"
+#include "lockfree_cuckoo.h"
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchmarkArgs args(argc, argv, "lockfree");
+        if (args.engine != "lockfree") throw std::invalid_argument("unknown engine " + args.engine);
+
+        // Initialize with 1 million capacity unless --capacity says otherwise
+        LockFreeCuckooHashSet<int> hashSet(args.workload->capacity);
+        prefillSet(hashSet, *args.workload);
+        runBenchmark(hashSet, args);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        std::cerr << "Usage: " << BenchmarkArgs::usage(argv[0], "lockfree") << std::endl;
+        return 1;
+    }
+    return 0;
+}
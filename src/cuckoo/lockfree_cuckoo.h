@@ -0,0 +1,570 @@
+// Lock-free bucketized cuckoo hash set with the interface of
+// StripedCuckooHashSet (striped_cuckoo.h), for comparing the two designs.
+//
+// Every slot is a 64-bit word: the key, a few state bits and a version that
+// every write bumps, so a CAS on the word fails if anything happened to the
+// slot since it was read. Short of allocating a new generation (below), no
+// operation ever waits on another:
+//
+// - A lookup reads all of the key's buckets. Seeing the key anywhere is a
+//   hit; a miss is only reported once a second read finds every word
+//   unchanged, so a key cannot slip past while moving between buckets.
+// - Inserts only ever write a key into its home slot, a fixed slot of its
+//   first-table bucket (whose occupant is kicked out first). Two inserts of
+//   one key thus race on one word, and an insert that found the key absent
+//   in an unchanged snapshot knows it cannot have arrived since without
+//   changing that word. The price is kicking: a home slot is taken about
+//   as often as the table is full, so at half load about half the inserts
+//   move a key first, where the striped set would take any free slot.
+// - A key moves in three CASes: its word is marked MOVING with the
+//   destination slot, the key is copied there marked INCOMING with the
+//   source slot, then the source is cleared and the mark dropped. Whoever
+//   meets a marked word finishes (or, if the destination was taken,
+//   abandons) the move, so a stalled mover holds nobody up. A helper copies
+//   only after re-reading the source, with a CAS expecting the destination
+//   word from before, so a late helper cannot bring back a removed key.
+// - Growing freezes the old generation a chunk at a time (FROZEN makes every
+//   later CAS on a word fail) and copies each frozen key into a generation
+//   twice the size. Operations that meet a frozen word help finish the copy
+//   and carry on in the new generation. A copier checks that its source word
+//   is not yet marked COPIED right before inserting, so no key is copied
+//   after the new generation went live. Replaced generations are freed
+//   through epochs (epoch.h). The one wait is for the successor to be
+//   allocated: the thread that claims the resize allocates it alone, and
+//   the others wait for it rather than each allocating (and, on huge pages,
+//   touching) a doubled table only to throw it away.
+//
+// Keys are integers of up to 32 bits and 0 is reserved as the empty slot.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "epoch.h"
+#include "hash_policy.h"
+#include "table_alloc.h"
+#include "table_common.h"
+#include "telemetry.h"
+#include "version_lock.h"
+
+template<typename T, int SLOTS = 8, typename Hash = MurmurHash, typename Alloc = HeapAlloc, int TABLES = 2>
+class LockFreeCuckooHashSet {
+    static_assert(std::is_integral<T>::value && sizeof(T) <= 4, "keys are integers of up to 32 bits");
+    static_assert(SLOTS >= 2 && SLOTS <= 8 && (SLOTS & (SLOTS - 1)) == 0, "a slot index fits in 3 bits");
+    static_assert(TABLES >= 2 && TABLES <= 4 && TABLES <= Hash::FUNCTIONS, "a table index fits in 2 bits");
+
+    // Slot word: key in bits 0-31, state in 32-40, version above
+    static const uint64_t KEY = 0xffffffffull;
+    static const uint64_t MOVING = 1ull << 32;    // being moved to the slot in WHERE
+    static const uint64_t INCOMING = 1ull << 33;  // moved here from the slot in WHERE
+    static const uint64_t FROZEN = 1ull << 34;    // generation being copied; never written again
+    static const uint64_t COPIED = 1ull << 35;    // frozen and copied
+    static const int WHERE = 36;                  // table (2 bits) and slot (3 bits)
+    static const uint64_t STATE = (1ull << 41) - 1;
+    static const uint64_t VERSION = 1ull << 41;
+
+    static const uint32_t EMPTY = 0;
+    static const int MAX_PATH = 5;     // max displacements per insert
+    static const int MAX_NODES = 256;  // buckets visited by one path search
+    static const int CHUNK = 1024;     // buckets frozen and copied as one unit
+    static const int PREFETCH_WINDOW = 16;  // keys whose buckets a batch call loads at once
+
+    static_assert(MAX_PATH < TableCounters::PATH_LENGTHS, "every kick path length is counted");
+
+    struct alignas(SLOTS * sizeof(uint64_t)) Bucket {
+        std::atomic<uint64_t> slot[SLOTS];
+
+        Bucket() {
+            for (int i = 0; i < SLOTS; i++) {
+                slot[i].store(EMPTY, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    // One generation. Once `next` is set it is being copied there: chunk c
+    // covers CHUNK buckets of one table and copied[c] tells whether it is done.
+    // While the successor is allocated `next` holds claimed().
+    struct Table {
+        int capacity;  // buckets per table, power of two
+        Hash hash;
+        Bucket* bucket[TABLES];
+        std::atomic<Table*> next{nullptr};
+        int chunks;
+        std::atomic<int> claimed{0};  // chunks handed out so far
+        std::atomic<bool>* copied;
+
+        Table(int capacity, const Hash& hash) : capacity(capacity), hash(hash) {
+            for (int i = 0; i < TABLES; i++) bucket[i] = Alloc::template allocate<Bucket>(capacity);
+            chunks = TABLES * ((capacity + CHUNK - 1) / CHUNK);
+            copied = new std::atomic<bool>[chunks];
+            for (int c = 0; c < chunks; c++) copied[c].store(false, std::memory_order_relaxed);
+        }
+
+        ~Table() {
+            for (int i = 0; i < TABLES; i++) Alloc::deallocate(bucket[i], capacity);
+            delete[] copied;
+        }
+    };
+
+    // A key and its hashes, the same in every generation
+    struct Hashed {
+        uint32_t key;
+        uint64_t h[TABLES];
+
+        Hashed(const Hash& hash, uint32_t x) : key(x) {
+            for (int w = 0; w < TABLES; w++) h[w] = hash(x, w);
+        }
+    };
+
+    // Where an insert stands: done, not needed, or the generation is
+    // being copied (FROZEN_OUT) or has no room (FULL) and must be left
+    enum Result { INSERTED, PRESENT, FROZEN_OUT, FULL };
+
+    // What a read of a key's buckets saw
+    struct View {
+        int at = -1;         // a word holding the key, as table * SLOTS + slot; one being moved if any
+        int sightings = 0;   // two while caught mid-move
+        bool frozen = false;
+    };
+
+    struct PathNode {
+        int which;
+        int bucket;
+        int parent;  // index into the search queue, -1 for the home slot
+        int slot;    // slot of the parent bucket whose key moves here
+        int depth;
+    };
+
+    std::atomic<Table*> table;
+    mutable EpochDomain epochs;  // frees replaced generations
+    TableTelemetry telemetry;
+
+    KeyCounter counts;
+
+    // Placeholder successor of a generation whose resize has been claimed
+    static Table* claimed() {
+        return reinterpret_cast<Table*>(uintptr_t(1));
+    }
+
+    static uint32_t bits(T x) {
+        return (uint32_t)(std::make_unsigned_t<T>)x;
+    }
+
+    static uint32_t keyOf(uint64_t w) {
+        return w & KEY;
+    }
+
+    // The next version of w, holding `state` (key and flags)
+    static uint64_t with(uint64_t w, uint64_t state) {
+        return ((w & ~STATE) + VERSION) | state;
+    }
+
+    static uint64_t where(int which, int slot) {
+        return (uint64_t)(which << 3 | slot) << WHERE;
+    }
+
+    static int whereTable(uint64_t w) {
+        return (w >> (WHERE + 3)) & 3;
+    }
+
+    static int whereSlot(uint64_t w) {
+        return (w >> WHERE) & 7;
+    }
+
+    // A key with no moves or copies pending
+    static bool plain(uint64_t w) {
+        return keyOf(w) != EMPTY && (w & STATE & ~KEY) == 0;
+    }
+
+    static int index(const Table* g, int which, const Hashed& k) {
+        return k.h[which] & (g->capacity - 1);
+    }
+
+    static int index(const Table* g, int which, uint32_t x) {
+        return g->hash(x, which) & (g->capacity - 1);
+    }
+
+    // Bits of the first hash above any bucket index
+    static int homeSlot(const Hashed& k) {
+        return (k.h[0] >> 40) & (SLOTS - 1);
+    }
+
+    static std::atomic<uint64_t>& slotAt(Table* g, int which, int b, int s) {
+        return g->bucket[which][b].slot[s];
+    }
+
+    View scan(const Table* g, const Hashed& k, uint64_t* words) const {
+        View v;
+        for (int w = 0; w < TABLES; w++) {
+            const Bucket& b = g->bucket[w][index(g, w, k)];
+            for (int s = 0; s < SLOTS; s++) {
+                uint64_t x = b.slot[s].load(std::memory_order_acquire);
+                words[w * SLOTS + s] = x;
+                v.frozen |= (x & FROZEN) != 0;
+                if (keyOf(x) == k.key) {
+                    if (v.at < 0 || !plain(x)) v.at = w * SLOTS + s;
+                    v.sightings++;
+                }
+            }
+        }
+        return v;
+    }
+
+    // Whether k's buckets still hold exactly `words`: if so, they held them
+    // all at once at some point between the two reads
+    bool unchanged(const Table* g, const Hashed& k, const uint64_t* words) const {
+        for (int w = 0; w < TABLES; w++) {
+            const Bucket& b = g->bucket[w][index(g, w, k)];
+            for (int s = 0; s < SLOTS; s++) {
+                if (b.slot[s].load(std::memory_order_acquire) != words[w * SLOTS + s]) return false;
+            }
+        }
+        return true;
+    }
+
+    // A batch call, prefetching every bucket of each key, since a lookup
+    // reads them all
+    template<typename Op>
+    void batch(const T* keys, size_t n, bool* out, Op op) {
+        prefetchedBatch<PREFETCH_WINDOW>(epochs, keys, n, out, [this](const T* first, const T* last) {
+            const Table* g = table.load(std::memory_order_acquire);
+            for (; first != last; ++first) {
+                Hashed k(g->hash, bits(*first));
+                for (int w = 0; w < TABLES; w++) __builtin_prefetch(&g->bucket[w][index(g, w, k)]);
+            }
+        }, op);
+    }
+
+    // Finish or abandon the move of the key in slot (which, b, s), whose
+    // word was m (marked MOVING)
+    void helpMove(Table* g, int which, int b, int s, uint64_t m) {
+        std::atomic<uint64_t>& src = slotAt(g, which, b, s);
+        uint32_t y = keyOf(m);
+        int tw = whereTable(m);
+        int ts = whereSlot(m);
+        std::atomic<uint64_t>& dst = slotAt(g, tw, index(g, tw, y), ts);
+
+        while (true) {
+            uint64_t d = dst.load(std::memory_order_acquire);
+            if (d & FROZEN) return;        // the copy takes y from either slot
+            if (keyOf(d) == y) break;      // copied
+            if ((d & STATE) != EMPTY) {    // taken: abandon the move
+                src.compare_exchange_strong(m, with(m, y));
+                return;
+            }
+            if (src.load(std::memory_order_acquire) != m) return;  // finished or abandoned meanwhile
+            dst.compare_exchange_strong(d, with(d, y | INCOMING | where(which, s)));
+        }
+        src.compare_exchange_strong(m, with(m, EMPTY));
+        settle(g, tw, index(g, tw, y), ts, dst.load(std::memory_order_acquire));
+    }
+
+    // Drop the INCOMING mark of the key in slot (which, b, s), whose word was
+    // d, once its source is cleared; if it is not, finish the move first
+    void settle(Table* g, int which, int b, int s, uint64_t d) {
+        if (!(d & INCOMING) || (d & FROZEN)) return;
+        uint32_t y = keyOf(d);
+        int fw = whereTable(d);
+        int fs = whereSlot(d);
+        int fb = index(g, fw, y);
+        uint64_t m = slotAt(g, fw, fb, fs).load(std::memory_order_acquire);
+        if (keyOf(m) == y && (m & MOVING) && whereTable(m) == which && whereSlot(m) == s) {
+            if (!(m & FROZEN)) helpMove(g, fw, fb, fs, m);
+            return;
+        }
+        slotAt(g, which, b, s).compare_exchange_strong(d, with(d, y));
+    }
+
+    // Help whatever move the word at table * SLOTS + slot of k's buckets
+    // is part of
+    void help(Table* g, const Hashed& k, int at, uint64_t w) {
+        int which = at / SLOTS;
+        int b = index(g, which, k);
+        if (w & MOVING) {
+            helpMove(g, which, b, at % SLOTS, w);
+        } else {
+            settle(g, which, b, at % SLOTS, w);
+        }
+    }
+
+    // Empty the home slot of k, which holds the plain key in word `home`:
+    // search breadth-first for the closest free slot reachable by moving
+    // keys to their other buckets, then make the moves backwards from it.
+    // Returns false if there is no such path; a path that changed under us
+    // counts as progress and the caller looks again.
+    bool kick(Table* g, const Hashed& k, uint64_t home) {
+        PathNode queue[MAX_NODES];
+        int hs = homeSlot(k);
+        int hb = index(g, 0, k);
+        uint32_t y = keyOf(home);
+
+        // The home key may also move within its bucket
+        int head = 0;
+        int tail = 0;
+        for (int w = 0; w < TABLES; w++) queue[tail++] = {w, index(g, w, y), -1, hs, 1};
+
+        while (head < tail) {
+            int n = head++;
+            const Bucket& b = g->bucket[queue[n].which][queue[n].bucket];
+            for (int s = 0; s < SLOTS; s++) {
+                if ((b.slot[s].load(std::memory_order_relaxed) & STATE) == EMPTY) {
+                    return movePath(g, queue, n, s, hb);
+                }
+            }
+            if (queue[n].depth == MAX_PATH) continue;
+            for (int s = 0; s < SLOTS && tail < MAX_NODES; s++) {
+                uint64_t z = b.slot[s].load(std::memory_order_relaxed);
+                if (!plain(z)) continue;
+                for (int w = 0; w < TABLES && tail < MAX_NODES; w++) {
+                    if (w != queue[n].which) {
+                        queue[tail++] = {w, index(g, w, keyOf(z)), n, s, queue[n].depth + 1};
+                    }
+                }
+            }
+        }
+        telemetry.add(TableTelemetry::RELOCATE_FAILURE);
+        return false;
+    }
+
+    // Make the moves of the path ending at queue[n], whose bucket has a free
+    // slot `free`, from its far end back to the home slot
+    bool movePath(Table* g, const PathNode* queue, int n, int free, int homeBucket) {
+        int hops = queue[n].depth;
+        for (; n >= 0; n = queue[n].parent) {
+            const PathNode& to = queue[n];
+            int fw = to.parent >= 0 ? queue[to.parent].which : 0;
+            int fb = to.parent >= 0 ? queue[to.parent].bucket : homeBucket;
+            std::atomic<uint64_t>& src = slotAt(g, fw, fb, to.slot);
+            uint64_t d = slotAt(g, to.which, to.bucket, free).load(std::memory_order_acquire);
+            uint64_t m = src.load(std::memory_order_acquire);
+            if ((d & STATE) != EMPTY || !plain(m) || index(g, to.which, keyOf(m)) != to.bucket) return true;
+
+            uint64_t marked = with(m, keyOf(m) | MOVING | where(to.which, free));
+            if (!src.compare_exchange_strong(m, marked)) return true;
+            helpMove(g, fw, fb, to.slot, marked);
+            if (keyOf(src.load(std::memory_order_acquire)) == keyOf(m)) return true;  // abandoned
+            free = to.slot;
+        }
+        telemetry.kickPath(hops);
+        return true;
+    }
+
+    // Insert k into g unless it is there. valid() is asked right before the
+    // key is written; false means it is no longer wanted.
+    template<typename Valid>
+    Result insert(Table* g, const Hashed& k, Valid valid) {
+        uint64_t words[TABLES * SLOTS];
+        int hs = homeSlot(k);
+        std::atomic<uint64_t>& home = slotAt(g, 0, index(g, 0, k), hs);
+
+        while (true) {
+            View v = scan(g, k, words);
+            if (v.frozen) return FROZEN_OUT;
+            if (v.at >= 0) return PRESENT;
+            if (!unchanged(g, k, words)) continue;
+
+            uint64_t w = words[hs];  // table 0 comes first
+            if ((w & STATE) == EMPTY) {
+                if (!valid()) return PRESENT;
+                if (home.compare_exchange_strong(w, with(w, k.key))) return INSERTED;
+            } else if (!plain(w)) {
+                help(g, k, hs, w);
+            } else if (!kick(g, k, w)) {
+                return FULL;
+            }
+        }
+    }
+
+    // Copy chunk c of g into n: freeze every word, then insert each key
+    // that is not marked COPIED yet and mark it. Any number of threads may
+    // copy the same chunk.
+    void copyChunk(Table* g, Table* n, int c) {
+        int perTable = g->chunks / TABLES;
+        int which = c / perTable;
+        int begin = (c % perTable) * CHUNK;
+        int end = std::min(g->capacity, begin + CHUNK);
+
+        for (int b = begin; b < end; b++) {
+            for (int s = 0; s < SLOTS; s++) {
+                std::atomic<uint64_t>& slot = slotAt(g, which, b, s);
+                uint64_t w = slot.load(std::memory_order_relaxed);
+                while (!(w & FROZEN) && !slot.compare_exchange_weak(w, w | FROZEN)) {}
+            }
+        }
+        for (int b = begin; b < end; b++) {
+            for (int s = 0; s < SLOTS; s++) {
+                std::atomic<uint64_t>& slot = slotAt(g, which, b, s);
+                uint64_t w = slot.load(std::memory_order_acquire);
+                if (w & COPIED) continue;
+                if (keyOf(w) != EMPTY) {
+                    Hashed k(n->hash, keyOf(w));
+                    auto valid = [&] { return slot.load(std::memory_order_acquire) == w; };
+                    for (Table* to = n;; to = to->next.load()) {
+                        Result r = insert(to, k, valid);
+                        if (r == INSERTED || r == PRESENT) break;
+                        resize(to);
+                    }
+                }
+                slot.compare_exchange_strong(w, w | COPIED);
+            }
+        }
+        g->copied[c].store(true, std::memory_order_release);
+    }
+
+    // Grow past g, which an insert found frozen or full: make sure it has a
+    // successor, help copy it there, and make the successor current if g
+    // was. The successor is allocated by whoever claims the resize. Every
+    // chunk is claimed once and then swept again, so the copy completes even
+    // if the thread that claimed a chunk stalls. Returns false if g cannot
+    // double.
+    bool resize(Table* g) {
+        uint64_t start = 0;
+        Table* n = g->next.load();
+        if (n == nullptr) {
+            if (g->capacity > INT_MAX / 2 / TABLES / SLOTS) return false;
+            if (g->next.compare_exchange_strong(n, claimed())) {
+                start = Ticks::now();
+                g->next.store(new Table(g->capacity * 2, g->hash));
+            }
+        }
+        int spins = 0;
+        while ((n = g->next.load()) == claimed()) spinWait(spins);
+
+        for (int c = g->claimed.fetch_add(1); c < g->chunks; c = g->claimed.fetch_add(1)) copyChunk(g, n, c);
+        for (int c = 0; c < g->chunks; c++) {
+            if (!g->copied[c].load(std::memory_order_acquire)) copyChunk(g, n, c);
+        }
+
+        Table* expected = g;
+        if (table.compare_exchange_strong(expected, n)) {
+            epochs.retire(g);  // readers may still be probing it; the list takes a brief lock
+        }
+        if (start != 0) {
+            telemetry.add(TableTelemetry::RESIZE);
+            telemetry.add(TableTelemetry::RESIZE_TICKS, Ticks::now() - start);
+        }
+        return true;
+    }
+
+public:
+    LockFreeCuckooHashSet(int initialCapacity, uint64_t seed = 714) {
+        int buckets = roundUpPow2((initialCapacity + TABLES * SLOTS - 1) / (TABLES * SLOTS));
+        table.store(new Table(buckets, Hash(seed)));
+    }
+
+    LockFreeCuckooHashSet(const LockFreeCuckooHashSet&) = delete;
+    LockFreeCuckooHashSet& operator=(const LockFreeCuckooHashSet&) = delete;
+
+    ~LockFreeCuckooHashSet() {
+        for (Table* g = table.load(); g != nullptr;) {
+            Table* n = g->next.load();
+            delete g;
+            g = n;
+        }
+    }
+
+    bool add(T x) {
+        if (bits(x) == EMPTY) return false;
+        auto pinned = epochs.pin();
+        Hashed k(table.load()->hash, bits(x));
+
+        while (true) {
+            Table* g = table.load();
+            Result r = insert(g, k, [] { return true; });
+            if (r == INSERTED) {
+                counts.add(1);
+                return true;
+            }
+            if (r == PRESENT || !resize(g)) return false;
+        }
+    }
+
+    bool remove(T x) {
+        if (bits(x) == EMPTY) return false;
+        auto pinned = epochs.pin();
+        Hashed k(table.load()->hash, bits(x));
+        uint64_t words[TABLES * SLOTS];
+
+        while (true) {
+            Table* g = table.load();
+            View v = scan(g, k, words);
+            if (v.frozen) {
+                resize(g);
+            } else if (v.at >= 0 && !plain(words[v.at])) {
+                help(g, k, v.at, words[v.at]);
+            } else if (v.sightings == 1) {
+                // The only copy, with no move pending
+                int which = v.at / SLOTS;
+                std::atomic<uint64_t>& slot = slotAt(g, which, index(g, which, k), v.at % SLOTS);
+                if (slot.compare_exchange_strong(words[v.at], with(words[v.at], EMPTY))) {
+                    counts.add(-1);
+                    return true;
+                }
+            } else if (v.sightings == 0 && unchanged(g, k, words)) {
+                return false;
+            }
+        }
+    }
+
+    bool contains(T x) const {
+        if (bits(x) == EMPTY) return false;
+        auto pinned = epochs.pin();
+        const Table* g = table.load(std::memory_order_acquire);
+        Hashed k(g->hash, bits(x));
+        uint64_t words[TABLES * SLOTS];
+
+        while (true) {
+            if (scan(g, k, words).at >= 0) return true;
+            if (unchanged(g, k, words)) return false;
+        }
+    }
+
+    // Batched forms: out[i] receives the result for keys[i]. Lookups for a
+    // window of keys are prefetched together to hide DRAM latency.
+    void contains_batch(const T* keys, size_t n, bool* out) {
+        batch(keys, n, out, [this](T x) { return contains(x); });
+    }
+
+    void add_batch(const T* keys, size_t n, bool* out) {
+        batch(keys, n, out, [this](T x) { return add(x); });
+    }
+
+    void remove_batch(const T* keys, size_t n, bool* out) {
+        batch(keys, n, out, [this](T x) { return remove(x); });
+    }
+
+    // Insert [first, last); here simply one add after another
+    template<typename It>
+    void bulk_load(It first, It last) {
+        for (; first != last; ++first) add(*first);
+    }
+
+    // Number of keys; exact when no writer is running
+    int size() const {
+        return counts.total();
+    }
+
+    // Number of keys the tables can hold
+    int getCapacity() const {
+        auto pinned = epochs.pin();
+        return TABLES * table.load()->capacity * SLOTS;
+    }
+
+    // Bytes held by the set and its live generations
+    size_t memoryBytes() const {
+        auto pinned = epochs.pin();
+        size_t bytes = sizeof(*this);
+        for (const Table* g = table.load(); g != nullptr && g != claimed(); g = g->next.load()) {
+            bytes += sizeof(Table) + (size_t)TABLES * g->capacity * sizeof(Bucket) + g->chunks;
+        }
+        return bytes;
+    }
+
+    // Kicks, failed path searches and resizes so far, summed over threads
+    TableCounters counters() const {
+        return telemetry.totals();
+    }
+};
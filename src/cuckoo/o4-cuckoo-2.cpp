@@ -0,0 +1,328 @@
+// concurrent_cuckoo.cpp, version 1 with its recursive_mutex stripes (two
+// vectors of initialCap mutexes, 40 bytes each) replaced by tables of 32-bit
+// versioned spin locks (version_lock.h), 16 to a cache line. Stripes are
+// taken in one global order, so resize takes them all instead of relying
+// on recursion.
+//
+// The stripe versions also serve lookups: contains() reads the versions of
+// its key's two stripes, probes, and retries if either moved meanwhile. For
+// that the buckets are fixed arrays of PROBE_SIZE atomic slots and a fill
+// count instead of vectors, and each table generation is freed through
+// epochs (epoch.h) once no lookup can still be probing it.
+#include <bits/stdc++.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "epoch.h"
+#include "version_lock.h"
+
+using namespace std;
+
+//––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––
+// Must include this line verbatim, for a fixed seed everywhere:
+static std::mt19937 gen(714);
+
+// Striped (fixed-locks) cuckoo hash set from §13.4.3
+class StripedCuckooHashSet {
+    static constexpr size_t PROBE_SIZE = 4;
+    static constexpr size_t THRESHOLD  = PROBE_SIZE/2;
+
+    // a probe set: its first size slots hold keys
+    struct Bucket {
+        atomic<int> size{0};
+        atomic<int> slot[PROBE_SIZE];
+    };
+
+    // one generation of both tables
+    struct Table {
+        explicit Table(size_t capacity)
+          : capacity(capacity), table0(capacity), table1(capacity) {}
+
+        size_t capacity;
+        vector<Bucket> table0, table1;
+    };
+
+    atomic<Table*> table;             // replaced only with every stripe held
+    VersionLockTable locks0, locks1;  // same size, index = bucket mod size
+    EpochDomain epochs;
+
+    // two independent hash functions
+    static size_t h0(const Table* t, int x) {
+        return std::hash<int>{}(x) % t->capacity;
+    }
+    static size_t h1(const Table* t, int x) {
+        // shift to get a second hash
+        return (std::hash<int>{}(x) >> 16) % t->capacity;
+    }
+
+    // acquire locks for bucket‐0 and bucket‐1 for x, ordered by stripe and
+    // then table; a resize may have replaced the table while we waited
+    Table* acquire(int x) {
+        while (true) {
+            Table* t = table;
+            size_t l0 = h0(t, x) & (locks0.size() - 1), l1 = h1(t, x) & (locks1.size() - 1);
+            if (l0 <= l1) {
+                locks0[l0].lock();
+                locks1[l1].lock();
+            } else {
+                locks1[l1].lock();
+                locks0[l0].lock();
+            }
+            if (table == t) return t;
+            locks0[l0].unlock(false);
+            locks1[l1].unlock(false);
+        }
+    }
+    void release(const Table* t, int x, bool changed = true) {
+        locks0[h0(t, x)].unlock(changed);
+        locks1[h1(t, x)].unlock(changed);
+    }
+
+    static bool has(const Bucket& b, int x) {
+        for (int i = 0, n = b.size.load(memory_order_relaxed); i < n; i++) {
+            if (b.slot[i].load(memory_order_relaxed) == x) return true;
+        }
+        return false;
+    }
+    static void push(Bucket& b, int x) {
+        int n = b.size.load(memory_order_relaxed);
+        b.slot[n].store(x, memory_order_relaxed);
+        b.size.store(n + 1, memory_order_relaxed);
+    }
+    static bool erase(Bucket& b, int x) {
+        int n = b.size.load(memory_order_relaxed);
+        for (int i = 0; i < n; i++) {
+            if (b.slot[i].load(memory_order_relaxed) != x) continue;
+            for (; i + 1 < n; i++) b.slot[i].store(b.slot[i + 1].load(memory_order_relaxed), memory_order_relaxed);
+            b.size.store(n - 1, memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // place x in its buckets without locking; false if both are full
+    static bool place(Table* t, int x) {
+        Bucket& b0 = t->table0[h0(t, x)];
+        Bucket& b1 = t->table1[h1(t, x)];
+        size_t n0 = b0.size.load(memory_order_relaxed), n1 = b1.size.load(memory_order_relaxed);
+        // preferentially go into the small probe sets
+        if (n0 < THRESHOLD) {
+            push(b0, x);
+        }
+        else if (n1 < THRESHOLD) {
+            push(b1, x);
+        }
+        // overflow slots up to PROBE_SIZE
+        else if (n0 < PROBE_SIZE) {
+            push(b0, x);
+        }
+        else if (n1 < PROBE_SIZE) {
+            push(b1, x);
+        }
+        else {
+            return false;
+        }
+        return true;
+    }
+
+    // resize doubles capacity and re-inserts all items
+    void resize(Table* seen) {
+        // lock every stripe, in acquire()'s order, to quiesce add/remove
+        // and send lookups to the new table
+        for (size_t i = 0; i < locks0.size(); i++) {
+            locks0[i].lock();
+            locks1[i].lock();
+        }
+        if (table != seen) {  // another thread resized first
+            for (size_t i = 0; i < locks0.size(); i++) {
+                locks0[i].unlock(false);
+                locks1[i].unlock(false);
+            }
+            return;
+        }
+
+        vector<int> all;
+        for (const vector<Bucket>* half : {&seen->table0, &seen->table1}) {
+            for (const Bucket& b : *half) {
+                for (int i = 0, n = b.size.load(memory_order_relaxed); i < n; i++) {
+                    all.push_back(b.slot[i].load(memory_order_relaxed));
+                }
+            }
+        }
+
+        // re-insert everything; if a bucket still overflows, double again
+        Table* next = nullptr;
+        for (size_t capacity = seen->capacity * 2; next == nullptr; capacity *= 2) {
+            next = new Table(capacity);
+            for (size_t i = 0; i < all.size() && next != nullptr; i++) {
+                if (!place(next, all[i])) {
+                    delete next;
+                    next = nullptr;
+                }
+            }
+        }
+
+        table.store(next, memory_order_release);
+        for (size_t i = 0; i < locks0.size(); i++) {
+            locks0[i].unlock(true);
+            locks1[i].unlock(true);
+        }
+        epochs.retire(seen);  // lookups may still be probing it
+    }
+
+public:
+    StripedCuckooHashSet(size_t initialCap)
+      : table(new Table(initialCap)),
+        locks0(initialCap), locks1(initialCap)
+    {}
+
+    ~StripedCuckooHashSet() {
+        delete table.load();
+    }
+
+    // add x if absent; return true on success
+    bool add(int x) {
+        auto pinned = epochs.pin();
+        Table* t = acquire(x);
+        // check presence
+        Bucket& b0 = t->table0[h0(t, x)];
+        Bucket& b1 = t->table1[h1(t, x)];
+        if (has(b0, x) || has(b1, x)) { release(t, x, false); return false; }
+
+        bool placed = place(t, x);
+        release(t, x, placed);
+
+        if (!placed) {
+            resize(t);
+            return add(x);
+        }
+        return true;
+    }
+
+    // remove x if present; return true on success
+    bool remove(int x) {
+        auto pinned = epochs.pin();
+        Table* t = acquire(x);
+        bool removed = erase(t->table0[h0(t, x)], x) || erase(t->table1[h1(t, x)], x);
+        release(t, x, removed);
+        return removed;
+    }
+
+    // contains(x)? Probes between reading the two stripe versions and
+    // validating them, and retries if a writer got in.
+    bool contains(int x) {
+        auto pinned = epochs.pin();
+        while (true) {
+            const Table* t = table.load(memory_order_acquire);
+            size_t i0 = h0(t, x), i1 = h1(t, x);
+            const VersionLock& l0 = locks0[i0];
+            const VersionLock& l1 = locks1[i1];
+            unsigned v0 = l0.read(), v1 = l1.read();
+            if (VersionLock::locked(v0 | v1)) {
+                cpuRelax();
+                continue;
+            }
+            bool found = has(t->table0[i0], x) || has(t->table1[i1], x);
+            if (l0.validate(v0) && l1.validate(v1)) return found;
+        }
+    }
+
+    // non-thread-safe count of all elements
+    size_t size() const {
+        const Table* t = table;
+        size_t cnt = 0;
+        for (size_t i = 0; i < t->capacity; i++) {
+            cnt += t->table0[i].size + t->table1[i].size;
+        }
+        return cnt;
+    }
+
+    size_t getCapacity() const { return table.load()->capacity; }
+
+    // non-thread-safe bulk initialize with random ints
+    void populate(size_t n) {
+        uniform_int_distribution<int> dist(0, int(getCapacity()*2));
+        for (size_t i = 0; i < n; i++) {
+            add(dist(gen));
+        }
+    }
+};
+
+//––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––––
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " <num_operations> <num_threads>\n";
+        return 1;
+    }
+    const size_t numOps    = stoull(argv[1]);
+    const int    numThreads= stoi(argv[2]);
+
+    const size_t initialCap = 10'000'000;
+    StripedCuckooHashSet set(initialCap);
+
+    // 1) populate to half capacity
+    const size_t initialSize = initialCap / 2;
+    set.populate(initialSize);
+
+    // 2) record the starting size
+    const size_t startSize = set.size();
+
+    // 3) prepare per-thread seeds
+    vector<uint32_t> seeds(numThreads);
+    for (int t = 0; t < numThreads; t++) {
+        seeds[t] = gen();
+    }
+
+    atomic<size_t> adds{0}, removes{0};
+    vector<thread> workers;
+    workers.reserve(numThreads);
+
+    // 4) benchmark
+    auto t0 = chrono::high_resolution_clock::now();
+    for (int t = 0; t < numThreads; t++) {
+        workers.emplace_back([&,t](){
+            mt19937  rng(seeds[t]);
+            uniform_int_distribution<int> opDist(1,100);
+            uniform_int_distribution<int> valDist(0,int(initialCap*2));
+
+            // split operations as evenly as possible
+            size_t base = numOps / numThreads;
+            size_t extra= (t==numThreads-1) ? (numOps % numThreads) : 0;
+            for (size_t i = 0, M = base+extra; i < M; i++) {
+                int op = opDist(rng);
+                int v  = valDist(rng);
+                if (op <= 80) {
+                    set.contains(v);
+                }
+                else if (op <= 90) {
+                    if (set.add(v)) adds++;
+                }
+                else {
+                    if (set.remove(v)) removes++;
+                }
+            }
+        });
+    }
+    for (auto &th : workers) th.join();
+    auto t1 = chrono::high_resolution_clock::now();
+
+    // 5) compute times & sizes
+    auto totalUs = chrono::duration_cast<chrono::microseconds>(t1 - t0).count();
+    double avgUs = double(totalUs) / numOps;
+    size_t expected = startSize + adds.load() - removes.load();
+    size_t finalSize = set.size();
+    size_t finalCap  = set.getCapacity();
+
+    // 6) print _exactly_ this block, in this order:
+    cout << "Total time: "               << totalUs      << "\n";
+    cout << "Average time per operation: " << avgUs        << "\n";
+    cout << "Hashset initial size: "      << startSize    << "\n";
+    cout << "Hashset initial capacity: "  << initialCap   << "\n";
+    cout << "Expected size: "             << expected     << "\n";
+    cout << "Final hashset size: "        << finalSize    << "\n";
+    cout << "Final hashset capacity: "    << finalCap     << "\n";
+
+    return 0;
+}
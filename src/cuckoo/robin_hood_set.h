@@ -0,0 +1,360 @@
+// Concurrent Robin Hood hash set: linear probing in which a key may take the
+// slot of any key that sits closer to its home than the new one would
+// (Celis, "Robin Hood Hashing", 1986), so probe lengths stay short and even.
+// Same interface as StripedCuckooHashSet, so the cuckoo driver can compare
+// it against cuckoo hashing on one harness.
+//
+// Along a run of occupied slots keys are ordered by home slot, so an insert
+// puts the key at the first slot holding a key closer to home and shifts the
+// rest of the run one slot right, up to the next hole; a remove shifts the
+// rest of the run back over it (backward-shift deletion, no tombstones). A
+// lookup stops at the first slot whose key is closer to home than the key
+// sought would be. Each slot word holds a key and its distance from home, 0
+// marking a free slot. The slot array runs MAX_PROBE past the last home slot
+// instead of wrapping around, and no key sits MAX_PROBE or more slots from
+// home: an insert that would push one that far doubles the table.
+//
+// Locks cover SEGMENT consecutive slots each (VersionLock, version_lock.h).
+// A writer locks segments in increasing order as its walk reaches them.
+// Lookups never lock: they note the version of each segment they enter and
+// retry if one moved. Resizing takes every segment and rehashes into a new
+// generation, and the old one is freed through epochs (epoch.h) once no
+// operation can still see it.
+//
+// Keys are integers of up to 32 bits and 0 is reserved, as in the other
+// engines, although free slots here are told apart by their distance.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "epoch.h"
+#include "hash_policy.h"
+#include "table_alloc.h"
+#include "table_common.h"
+#include "telemetry.h"
+#include "version_lock.h"
+
+template<typename T, typename Hash = MurmurHash, typename Alloc = HeapAlloc>
+class RobinHoodHashSet {
+    static_assert(std::is_integral<T>::value && sizeof(T) <= 4, "a key shares its slot word with its distance");
+
+    static const T EMPTY = 0;          // reserved key, rejected by every call
+    static const int MAX_PROBE = 64;   // slots from home, exclusive
+    static const int SEGMENT = 256;    // slots per lock
+    static const int PREFETCH_WINDOW = 16;  // keys whose slots a batch call loads at once
+    static const uint64_t DIST = 1ull << 32;  // distance from home plus one, above the key
+
+    static_assert(MAX_PROBE < SEGMENT, "a lookup spans at most two segments");
+
+    struct alignas(64) Segment {
+        VersionLock lock;
+    };
+
+    struct Table {
+        int capacity;  // home slots, power of two
+        int slots;     // capacity + MAX_PROBE
+        int segments;
+        Hash hash;
+        std::atomic<uint64_t>* slot;
+        Segment* segment;
+
+        Table(int capacity, const Hash& hash)
+            : capacity(capacity), slots(capacity + MAX_PROBE),
+              segments((slots + SEGMENT - 1) / SEGMENT), hash(hash) {
+            slot = Alloc::template allocate<std::atomic<uint64_t>>(slots);
+            segment = Alloc::template allocate<Segment>(segments);
+        }
+
+        ~Table() {
+            Alloc::deallocate(slot, slots);
+            Alloc::deallocate(segment, segments);
+        }
+    };
+
+    enum Result { INSERTED, PRESENT, FULL };
+
+    std::atomic<Table*> table;
+    mutable EpochDomain epochs;  // frees replaced generations
+    TableTelemetry telemetry;
+
+    KeyCounter counts;
+
+    static uint32_t bits(T x) {
+        return (uint32_t)(std::make_unsigned_t<T>)x;
+    }
+
+    static uint32_t keyOf(uint64_t w) {
+        return (uint32_t)w;
+    }
+
+    // Distance from home plus one; 0 for a free slot
+    static int distOf(uint64_t w) {
+        return w >> 32;
+    }
+
+    static int home(const Table* t, uint32_t k) {
+        return t->hash(k, 0) & (t->capacity - 1);
+    }
+
+    static uint64_t load(const Table* t, int i) {
+        return t->slot[i].load(std::memory_order_relaxed);
+    }
+
+    static void store(Table* t, int i, uint64_t w) {
+        t->slot[i].store(w, std::memory_order_relaxed);
+    }
+
+    void lockSegment(VersionLock& l) const {
+        if (l.try_lock()) return;
+        uint64_t start = Ticks::now();
+        l.lock();
+        telemetry.add(TableTelemetry::LOCK_WAIT);
+        telemetry.add(TableTelemetry::LOCK_WAIT_TICKS, Ticks::now() - start);
+    }
+
+    // The segments a writer holds, [first, last], extended as its walk
+    // goes on
+    struct Held {
+        Table* t;
+        int first;
+        int last;
+    };
+
+    // Lock the segment of home slot h; false, with nothing held, if the
+    // table was replaced before we had it
+    bool lockHome(Table* t, int h, Held& held) {
+        held = {t, h / SEGMENT, h / SEGMENT};
+        lockSegment(t->segment[held.first].lock);
+        if (table.load() == t) return true;
+        t->segment[held.first].lock.unlock(false);
+        return false;
+    }
+
+    void reach(Held& held, int i) {
+        while (held.last < i / SEGMENT) lockSegment(held.t->segment[++held.last].lock);
+    }
+
+    static void unlock(const Held& held, bool changed) {
+        for (int s = held.first; s <= held.last; s++) held.t->segment[s].lock.unlock(changed);
+    }
+
+    // Insert k into t. reach(i) is called before slot i is touched, so the
+    // caller can lock its way along, or do nothing if it owns the table.
+    template<typename Reach>
+    Result insert(Table* t, uint32_t k, Reach reach) {
+        int h = home(t, k);
+        int p = h;
+        int d = 1;
+        for (;; p++, d++) {
+            reach(p);
+            uint64_t w = load(t, p);
+            if (distOf(w) < d) break;
+            if (keyOf(w) == k) return PRESENT;
+        }
+        if (d >= MAX_PROBE) return FULL;
+
+        // Every key from p up to the next hole moves one slot further out.
+        // The last slot is always free, since no key gets that far from home.
+        int e = p;
+        for (;; e++) {
+            reach(e);
+            uint64_t w = load(t, e);
+            if (w == 0) break;
+            if (distOf(w) + 1 >= MAX_PROBE) return FULL;
+        }
+        for (int i = e; i > p; i--) store(t, i, load(t, i - 1) + DIST);
+        store(t, p, (uint64_t)d << 32 | k);
+        return INSERTED;
+    }
+
+    // Replace t by a table twice the size, unless that already happened.
+    // Taking every segment in order waits out the writers of t and, since
+    // it bumps every version, sends its readers to the new table. Returns
+    // false if the table cannot grow.
+    bool resize(Table* t) {
+        uint64_t start = Ticks::now();
+        for (int s = 0; s < t->segments; s++) lockSegment(t->segment[s].lock);
+        if (table.load() != t) {
+            for (int s = 0; s < t->segments; s++) t->segment[s].lock.unlock(false);
+            return true;
+        }
+
+        Table* n = nullptr;
+        for (int capacity = t->capacity; n == nullptr;) {
+            if (capacity > INT_MAX / 2 - MAX_PROBE) {
+                for (int s = 0; s < t->segments; s++) t->segment[s].lock.unlock(false);
+                return false;
+            }
+            capacity *= 2;
+            n = new Table(capacity, t->hash);
+            for (int i = 0; i < t->slots && n != nullptr; i++) {
+                uint64_t w = load(t, i);
+                if (w != 0 && insert(n, keyOf(w), [](int) {}) == FULL) {
+                    delete n;
+                    n = nullptr;
+                }
+            }
+        }
+
+        table.store(n, std::memory_order_release);
+        for (int s = 0; s < t->segments; s++) t->segment[s].lock.unlock(true);
+        epochs.retire(t);  // lock-free readers may still be probing it
+        telemetry.add(TableTelemetry::RESIZE);
+        telemetry.add(TableTelemetry::RESIZE_TICKS, Ticks::now() - start);
+        return true;
+    }
+
+    // A batch call, prefetching the home slot of each key
+    template<typename Op>
+    void batch(const T* keys, size_t n, bool* out, Op op) {
+        prefetchedBatch<PREFETCH_WINDOW>(epochs, keys, n, out, [this](const T* first, const T* last) {
+            const Table* t = table.load(std::memory_order_acquire);
+            for (; first != last; ++first) __builtin_prefetch(&t->slot[home(t, bits(*first))]);
+        }, op);
+    }
+
+public:
+    RobinHoodHashSet(int initialCapacity, uint64_t seed = 714) {
+        table.store(new Table(roundUpPow2(initialCapacity), Hash(seed)));
+    }
+
+    RobinHoodHashSet(const RobinHoodHashSet&) = delete;
+    RobinHoodHashSet& operator=(const RobinHoodHashSet&) = delete;
+
+    ~RobinHoodHashSet() {
+        delete table.load();
+    }
+
+    bool add(T x) {
+        if (x == EMPTY) return false;
+        auto pinned = epochs.pin();
+        while (true) {
+            Table* t = table.load();
+            Held held;
+            if (!lockHome(t, home(t, bits(x)), held)) continue;
+            Result r = insert(t, bits(x), [&](int i) { reach(held, i); });
+            unlock(held, r == INSERTED);
+            if (r == INSERTED) counts.add(1);
+            if (r != FULL) return r == INSERTED;
+            if (!resize(t)) return false;
+        }
+    }
+
+    bool remove(T x) {
+        if (x == EMPTY) return false;
+        auto pinned = epochs.pin();
+        uint32_t k = bits(x);
+        while (true) {
+            Table* t = table.load();
+            int h = home(t, k);
+            Held held;
+            if (!lockHome(t, h, held)) continue;
+
+            int i = h;
+            for (int d = 1;; i++, d++) {
+                reach(held, i);
+                uint64_t w = load(t, i);
+                if (distOf(w) < d) {
+                    unlock(held, false);
+                    return false;
+                }
+                if (keyOf(w) == k) break;
+            }
+
+            // Pull the rest of the run back until a hole or a key at home
+            for (;; i++) {
+                reach(held, i + 1);
+                uint64_t w = load(t, i + 1);
+                if (distOf(w) <= 1) break;
+                store(t, i, w - DIST);
+            }
+            store(t, i, 0);
+            unlock(held, true);
+            counts.add(-1);
+            return true;
+        }
+    }
+
+    bool contains(T x) const {
+        if (x == EMPTY) return false;
+        auto pinned = epochs.pin();
+        uint32_t k = bits(x);
+        while (true) {
+            const Table* t = table.load(std::memory_order_acquire);
+            int h = home(t, k);
+
+            // The walk may run into the next segment, whose version is then
+            // taken on entry
+            const VersionLock* lock[2];
+            unsigned v[2];
+            int segments = 0;
+            bool found = false;
+            for (int i = h, d = 1;; i++, d++) {
+                if (segments == 0 || i % SEGMENT == 0) {
+                    lock[segments] = &t->segment[i / SEGMENT].lock;
+                    v[segments] = lock[segments]->read();
+                    if (VersionLock::locked(v[segments++])) break;
+                }
+                uint64_t w = load(t, i);
+                if (distOf(w) < d) break;
+                if (keyOf(w) == k) {
+                    found = true;
+                    break;
+                }
+            }
+
+            bool unchanged = true;
+            for (int s = 0; s < segments; s++) unchanged &= lock[s]->validate(v[s]);
+            if (unchanged && !VersionLock::locked(v[segments - 1])) return found;
+            cpuRelax();
+        }
+    }
+
+    // Batched forms: out[i] receives the result for keys[i]. Lookups for a
+    // window of keys are prefetched together to hide DRAM latency.
+    void contains_batch(const T* keys, size_t n, bool* out) {
+        batch(keys, n, out, [this](T x) { return contains(x); });
+    }
+
+    void add_batch(const T* keys, size_t n, bool* out) {
+        batch(keys, n, out, [this](T x) { return add(x); });
+    }
+
+    void remove_batch(const T* keys, size_t n, bool* out) {
+        batch(keys, n, out, [this](T x) { return remove(x); });
+    }
+
+    // Insert [first, last); here simply one add after another
+    template<typename It>
+    void bulk_load(It first, It last) {
+        for (; first != last; ++first) add(*first);
+    }
+
+    // Number of keys; exact when no writer is running
+    int size() const {
+        return counts.total();
+    }
+
+    // Number of home slots, one key each
+    int getCapacity() const {
+        auto pinned = epochs.pin();
+        return table.load()->capacity;
+    }
+
+    // Bytes held by the set and its table
+    size_t memoryBytes() const {
+        auto pinned = epochs.pin();
+        const Table* t = table.load();
+        return sizeof(*this) + sizeof(Table) + (size_t)t->slots * sizeof(std::atomic<uint64_t>) +
+               (size_t)t->segments * sizeof(Segment);
+    }
+
+    // Resizes and lock waits so far, summed over threads
+    TableCounters counters() const {
+        return telemetry.totals();
+    }
+};
@@ -0,0 +1,1507 @@
+// Bucketized striped cuckoo hash table, the engine behind
+// StripedCuckooHashSet (below) and CuckooHashMap (cuckoo_map.h).
+//
+// TABLES tables of buckets (two by default), each indexed by its own hash
+// function; every bucket holds SLOTS keys and is aligned so it never
+// straddles a cache line, so a lookup is at most TABLES line fetches that
+// cover TABLES * SLOTS candidate slots. A third or fourth table costs a probe
+// but lets the tables fill much further before they must grow. Bucket
+// counts are powers of two, so a bucket index is a mask of the hash, and
+// doubling the table splits bucket b into buckets b and b + capacity.
+//
+// Locks are striped: stripe s of table i protects every bucket b of table i
+// with (b & (lockCapacity - 1)) == s. Because lockCapacity divides the bucket
+// count, a key's stripes depend only on its hash and survive a resize. The
+// stripe array is refinable: each resize doubles it along with the table, so
+// there is always one stripe per BUCKETS_PER_STRIPE buckets. The resizing
+// thread marks itself owner, waits for current holders to drain, and swaps in
+// the larger array; acquire() backs off while another thread owns the array.
+//
+// Next to the buckets each table keeps a word of 8-bit tags per bucket, one
+// per slot, taken from hash bits the bucket index does not use (0 marks a free
+// slot). Probes compare tags first and only read keys whose tag matches, so a
+// miss usually touches one small, cache-resident tag word instead of the
+// colder key array.
+//
+// Each stripe also carries a version counter that writers make odd while they
+// modify a bucket of the stripe. contains() never locks: it snapshots the
+// key's versions, probes, and retries only if one of them moved (a seqlock), so
+// readers never write a shared cache line.
+//
+// Resizing is incremental. The doubled generation is hung off the current one
+// and filled one stripe at a time: whoever holds a stripe while a resize is in
+// progress moves that stripe's keys forward before touching it, and the thread
+// that started the resize sweeps the rest. Readers pick the old or new bucket
+// by the stripe's migrated flag, so no operation waits for the whole rehash.
+// Every operation pins an epoch (epoch.h) while it uses a generation or
+// stripe array, and a replaced one is freed once no pinned operation can
+// still see it; the last of them to unpin frees it.
+//
+// Hashing is a seeded policy (hash_policy.h) carried by every table
+// generation and stripe array. When an insert finds no cuckoo path while the
+// table is still well below its normal maximum load, the hash is to blame
+// rather than the capacity: the table is rebuilt at the same size under a
+// fresh seed, with all writers held off, and only doubles if that fails too.
+// A key that still finds no path goes to a small stash; the table grows only
+// once the stash is full, and stashed keys are put back after it has grown.
+//
+// A map keeps a value cell per slot in an array parallel to the buckets, so
+// key probes stay dense. Values that fit a lock-free atomic live in the cell
+// itself and are read optimistically like keys; anything larger lives out of
+// line behind a pointer in the cell and is only read under the key's stripes.
+// Keys are integers and 0 is reserved as the empty slot.
+//
+// Bucket, tag, value and stripe arrays come from an allocation policy
+// (table_alloc.h), so large tables can sit on huge pages. A set can be bulk
+// loaded from every core, each thread filling the stripes it owns, and saved
+// to or loaded from a snapshot file (table_snapshot.h). Kicks, stash use,
+// resizes and lock waits are counted per thread (telemetry.h).
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "epoch.h"
+#include "hash_policy.h"
+#include "table_alloc.h"
+#include "table_snapshot.h"
+#include "table_common.h"
+#include "telemetry.h"
+#include "version_lock.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Marks a function whose plain loads race with writers by design, for
+// ThreadSanitizer to leave alone (see StripedCuckooTable::seqlockLoad)
+#if defined(__SANITIZE_THREAD__)
+#define NO_SANITIZE_THREAD __attribute__((no_sanitize("thread")))
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define NO_SANITIZE_THREAD __attribute__((no_sanitize("thread")))
+#endif
+#endif
+#ifndef NO_SANITIZE_THREAD
+#define NO_SANITIZE_THREAD
+#endif
+
+// Reader-writer spin lock in one 32-bit word: a writer bit, a pending bit
+// and a reader count. Readers share the lock; a writer waiting for them to
+// leave sets the pending bit, which holds off new readers so a steady
+// stream of them cannot starve it. Meets Lockable and SharedLockable.
+class RWSpinLock {
+public:
+    void lock() {
+        int spins = 0;
+        uint32_t w = word.load(std::memory_order_relaxed);
+        while (true) {
+            if ((w & (WRITER | READERS)) == 0) {
+                if (word.compare_exchange_weak(w, WRITER, std::memory_order_acquire)) return;
+                continue;
+            }
+            if ((w & PENDING) == 0) word.fetch_or(PENDING, std::memory_order_relaxed);
+            spinWait(spins);
+            w = word.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool try_lock() {
+        uint32_t w = word.load(std::memory_order_relaxed);
+        return (w & (WRITER | READERS)) == 0 && word.compare_exchange_strong(w, WRITER, std::memory_order_acquire);
+    }
+
+    void unlock() {
+        word.fetch_and(~WRITER, std::memory_order_release);  // keeps other writers' pending bit
+    }
+
+    void lock_shared() {
+        int spins = 0;
+        uint32_t w = word.load(std::memory_order_relaxed);
+        while (true) {
+            if ((w & (WRITER | PENDING)) == 0) {
+                if (word.compare_exchange_weak(w, w + 1, std::memory_order_acquire)) return;
+                continue;
+            }
+            spinWait(spins);
+            w = word.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool try_lock_shared() {
+        uint32_t w = word.load(std::memory_order_relaxed);
+        return (w & (WRITER | PENDING)) == 0 && word.compare_exchange_strong(w, w + 1, std::memory_order_acquire);
+    }
+
+    void unlock_shared() {
+        word.fetch_sub(1, std::memory_order_release);
+    }
+
+private:
+    static const uint32_t WRITER = 1u << 31;
+    static const uint32_t PENDING = 1u << 30;
+    static const uint32_t READERS = PENDING - 1;
+    std::atomic<uint32_t> word{0};
+};
+
+// Value type of a set: nothing is stored next to the keys
+struct NoValue {};
+
+// Whether V can be kept in a lock-free atomic
+template<typename V, bool = std::is_trivially_copyable<V>::value && sizeof(V) <= 8>
+struct FitsInline : std::integral_constant<bool, std::atomic<V>::is_always_lock_free> {};
+
+template<typename V>
+struct FitsInline<V, false> : std::false_type {};
+
+// How a table stores the value of each slot
+template<typename V>
+struct ValueTraits {
+    static constexpr bool none = std::is_same<V, NoValue>::value;
+    static constexpr bool inlined = !none && FitsInline<V>::value;
+    using Cell = std::conditional_t<none, NoValue, std::conditional_t<inlined, std::atomic<V>, std::atomic<V*>>>;
+};
+
+template<typename T, typename V, int SLOTS = 8, typename Hash = MurmurHash, typename Alloc = HeapAlloc,
+         int TABLES = 2>
+class StripedCuckooTable {
+protected:
+    using Traits = ValueTraits<V>;
+    using Cell = typename Traits::Cell;
+
+    static_assert((SLOTS * sizeof(T) & (SLOTS * sizeof(T) - 1)) == 0,
+                  "bucket size must be a power of two");
+    static_assert(SLOTS <= 8, "a bucket's tags must fit in one 64-bit word");
+    static_assert(std::is_integral<T>::value, "keys are integers, 0 marks an empty slot");
+    static_assert(TABLES >= 2 && TABLES <= Hash::FUNCTIONS, "one hash function per table");
+
+    struct alignas(SLOTS * sizeof(T)) Bucket {
+        std::atomic<T> slot[SLOTS];
+
+        Bucket() {
+            for (int i = 0; i < SLOTS; i++) {
+                slot[i].store(EMPTY, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    // One generation of the table. While it is being doubled, `next` points
+    // at the new generation and migrated[i][s] tells whether stripe s of
+    // table i has been moved there; both are set up by resize().
+    struct Table {
+        int capacity;       // buckets per table, power of two
+        Hash hash;
+        int rehashes = 0;   // re-seeds at this capacity so far
+        Bucket* bucket[TABLES];
+        std::atomic<uint64_t>* tags[TABLES];  // one tag byte per slot
+        Cell* values[TABLES] = {};            // SLOTS cells per bucket, maps only
+        std::atomic<Table*> next{nullptr};
+        std::atomic<bool>* migrated[TABLES] = {};
+        int stripes = 0;                // length of migrated[i]
+        std::atomic<int> remaining{0};  // stripes not yet migrated
+        void* mapping = nullptr;        // snapshot holding the arrays, if loaded
+        size_t mapped = 0;
+
+        Table(int capacity, const Hash& hash) : capacity(capacity), hash(hash) {
+            for (int i = 0; i < TABLES; i++) {
+                bucket[i] = Alloc::template allocate<Bucket>(capacity);
+                tags[i] = Alloc::template allocate<std::atomic<uint64_t>>(capacity);  // all free
+                if constexpr (!Traits::none) {
+                    values[i] = Alloc::template allocate<Cell>((size_t)capacity * SLOTS);
+                }
+            }
+        }
+
+        // Arrays inside a mapped snapshot; the table unmaps it when freed
+        Table(int capacity, const Hash& hash, void* mapping, size_t mapped, const size_t* offset)
+            : capacity(capacity), hash(hash), mapping(mapping), mapped(mapped) {
+            char* base = static_cast<char*>(mapping);
+            for (int i = 0; i < TABLES; i++) {
+                bucket[i] = reinterpret_cast<Bucket*>(base + offset[i]);
+                tags[i] = reinterpret_cast<std::atomic<uint64_t>*>(base + offset[TABLES + i]);
+            }
+        }
+
+        ~Table() {
+            for (int i = 0; i < TABLES; i++) {
+                if (mapping == nullptr) {
+                    Alloc::deallocate(bucket[i], capacity);
+                    Alloc::deallocate(tags[i], capacity);
+                }
+                if constexpr (!Traits::none) {
+                    Alloc::deallocate(values[i], (size_t)capacity * SLOTS);
+                }
+                delete[] migrated[i];
+            }
+            if (mapping != nullptr) Snapshot::unmap(mapping, mapped);
+        }
+    };
+
+    // A lock stripe: two words, eight to a cache line, so the stripes cost
+    // half a byte per slot and the versions readers sample stay cached.
+    // Neighbors share a line, but with a stripe per 16 buckets two writers
+    // rarely meet on one. Writers hold the lock exclusively and make the
+    // version odd while changing the stripe; readers of out-of-line values
+    // share it.
+    struct Stripe {
+        RWSpinLock lock;
+        std::atomic<unsigned> version{0};
+    };
+
+    // A generation of the stripe array; replaced as a whole when refined or
+    // when the table is re-seeded, so it always hashes like the live table
+    struct LockArray {
+        int capacity;  // stripes per table, power of two
+        Hash hash;
+        Stripe* stripe[TABLES];
+
+        LockArray(int capacity, const Hash& hash) : capacity(capacity), hash(hash) {
+            for (int i = 0; i < TABLES; i++) stripe[i] = Alloc::template allocate<Stripe>(capacity);
+        }
+
+        ~LockArray() {
+            for (int i = 0; i < TABLES; i++) Alloc::deallocate(stripe[i], capacity);
+        }
+    };
+
+    std::atomic<Table*> table;
+    std::atomic<LockArray*> locks;
+    std::atomic<const void*> owner{nullptr};  // thread refining the stripes
+    mutable EpochDomain epochs;  // frees replaced generations and stripe arrays
+    TableTelemetry telemetry;
+    static const T EMPTY = 0;
+    static const int MAX_PATH = 5;     // max displacements per insert
+    static const int MAX_NODES = 256;  // buckets visited by one path search
+    static const int BUCKETS_PER_STRIPE = 16;
+    static const int PREFETCH_WINDOW = 16;  // keys in flight per batch step
+    static const int MAX_REHASHES = 3;      // re-seeds before a table doubles
+    static const int REHASH_LOAD = 90;      // percent; fuller tables double
+    static const int STASH_SIZE = 32;
+    static const int BULK_LOAD = 90;        // percent; bulk loads grow the table first
+    static const int BULK_CHUNK = 16384;    // min keys per bulk-load worker
+    static_assert(MAX_PATH < TableCounters::PATH_LENGTHS, "every kick path length is counted");
+
+    // Keys no cuckoo path could place. An entry is written under its key's
+    // stripes, with their versions odd, exactly like a slot, so lock-free
+    // readers validate it the same way; `lock` only serializes writers
+    // choosing a free entry. Readers skip the stash while count is 0.
+    struct alignas(64) Stash {
+        std::atomic<T> key[STASH_SIZE];
+        Cell value[STASH_SIZE];
+        std::atomic<int> count{0};
+        std::mutex lock;
+
+        Stash() {
+            for (int j = 0; j < STASH_SIZE; j++) {
+                key[j].store(EMPTY, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    Stash stash;
+
+    KeyCounter counts;
+
+    // Bits 32-39 of the second hash, never used by a bucket index; never 0
+    static uint8_t tagOf(uint64_t h1) {
+        uint8_t tag = h1 >> 32;
+        return tag ? tag : 1;
+    }
+
+    // A key and its hashes, computed once per operation. Valid for every
+    // table and stripe array sharing the seed it was computed under.
+    struct Hashed {
+        T key;
+        uint64_t h[TABLES];
+        uint8_t tag;
+
+        Hashed(const Hash& hash, T x) : key(x) {
+            for (int w = 0; w < TABLES; w++) h[w] = hash(x, w);
+            tag = tagOf(h[1]);
+        }
+    };
+
+    static int index(const Table* t, int which, T x) {
+        return t->hash(x, which) & (t->capacity - 1);
+    }
+
+    static int index(const Table* t, int which, const Hashed& k) {
+        return k.h[which] & (t->capacity - 1);
+    }
+
+    static int stripeIndex(const LockArray* la, int which, const Hashed& k) {
+        return k.h[which] & (la->capacity - 1);
+    }
+
+    // The stripe array cannot be replaced while any stripe is held, so the
+    // holders of a stripe may use these
+    int stripeIndex(int which, const Hashed& k) const {
+        return stripeIndex(locks.load(), which, k);
+    }
+
+    Stripe& stripe(int which, const Hashed& k) const {
+        LockArray* la = locks.load();
+        return la->stripe[which][stripeIndex(la, which, k)];
+    }
+
+    // Identifies the calling thread as the owner of the stripe array
+    static const void* self() {
+        static thread_local char tag;
+        return &tag;
+    }
+
+    // Lock management. acquire() hashes x under the stripe array it locks;
+    // the result stays valid until release(). Shared holders may only read
+    // x's buckets: they must not write, and so must not migrate, them.
+    // Only a lock that is not free at once is timed.
+    void lock(Stripe& s, bool shared) const {
+        if (shared ? s.lock.try_lock_shared() : s.lock.try_lock()) return;
+        uint64_t start = Ticks::now();
+        if (shared) {
+            s.lock.lock_shared();
+        } else {
+            s.lock.lock();
+        }
+        telemetry.add(TableTelemetry::LOCK_WAIT);
+        telemetry.add(TableTelemetry::LOCK_WAIT_TICKS, Ticks::now() - start);
+    }
+
+    static void unlock(Stripe& s, bool shared) {
+        if (shared) {
+            s.lock.unlock_shared();
+        } else {
+            s.lock.unlock();
+        }
+    }
+
+    Hashed acquire(T x, bool shared = false) const {
+        const void* me = self();
+        while (true) {
+            if (owner.load() != nullptr && owner.load() != me) {
+                uint64_t start = Ticks::now();
+                while (owner.load() != nullptr && owner.load() != me) cpuRelax();
+                telemetry.add(TableTelemetry::LOCK_WAIT);
+                telemetry.add(TableTelemetry::LOCK_WAIT_TICKS, Ticks::now() - start);
+            }
+
+            // Always in table order, so lockers cannot deadlock
+            LockArray* la = locks.load();
+            Hashed k(la->hash, x);
+            for (int w = 0; w < TABLES; w++) lock(la->stripe[w][stripeIndex(la, w, k)], shared);
+
+            // Refinement started after our check: back off and retry
+            const void* who = owner.load();
+            if ((who == nullptr || who == me) && locks.load() == la) return k;
+            for (int w = 0; w < TABLES; w++) unlock(la->stripe[w][stripeIndex(la, w, k)], shared);
+        }
+    }
+
+    void release(const Hashed& k, bool shared = false) const {
+        for (int w = 0; w < TABLES; w++) unlock(stripe(w, k), shared);
+    }
+
+    // Version bumps around a modification; the stripe's mutex must be held
+    static void writeBegin(Stripe& s) {
+        s.version.store(s.version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    static void writeEnd(Stripe& s) {
+        s.version.store(s.version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void writeBegin(const Hashed& k) {
+        for (int w = 0; w < TABLES; w++) writeBegin(stripe(w, k));
+    }
+
+    void writeEnd(const Hashed& k) {
+        for (int w = 0; w < TABLES; w++) writeEnd(stripe(w, k));
+    }
+
+    // Bitmask of the slots whose tag byte in `tags` equals `tag`: a byte
+    // compare and movemask with SSE2, otherwise a SWAR zero-byte search
+    static unsigned tagMatches(uint64_t tags, uint8_t tag) {
+#ifdef __SSE2__
+        __m128i eq = _mm_cmpeq_epi8(_mm_cvtsi64_si128(tags), _mm_set1_epi8(tag));
+        return _mm_movemask_epi8(eq) & ((1u << SLOTS) - 1);
+#else
+        const uint64_t low7 = 0x7f7f7f7f7f7f7f7fULL;
+        uint64_t v = tags ^ (0x0101010101010101ULL * tag);
+        uint64_t zero = ~(((v & low7) + low7) | v | low7);  // top bit of each zero byte
+        return (((zero >> 7) * 0x0102040810204080ULL) >> 56) & ((1u << SLOTS) - 1);
+#endif
+    }
+
+#ifdef __AVX2__
+    // All slots of b in one vector load: a seqlock read. The load is not
+    // atomic, so a concurrent setSlot can tear it, but every caller either
+    // holds b's stripe, which setSlot needs, or is probe(), which throws the
+    // result away unless the stripe versions it sampled are unchanged.
+    // ThreadSanitizer cannot follow that, so it is told to skip this load.
+    NO_SANITIZE_THREAD static __m256i seqlockLoad(const Bucket& b) {
+        return _mm256_load_si256(reinterpret_cast<const __m256i*>(b.slot));
+    }
+#endif
+
+    // First slot among `candidates` of b holding x, or -1. With AVX2 a
+    // 32-byte bucket of integer keys is one vector compare plus a movemask;
+    // anything else checks the candidates one by one.
+    static int findSlot(const Bucket& b, T x, unsigned candidates) {
+#ifdef __AVX2__
+        if constexpr (std::is_integral<T>::value && SLOTS * sizeof(T) == 32) {
+            __m256i keys = seqlockLoad(b);
+            unsigned mask = 0;
+            if constexpr (sizeof(T) == 4) {
+                __m256i eq = _mm256_cmpeq_epi32(keys, _mm256_set1_epi32(x));
+                mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+            } else {
+                __m256i eq = _mm256_cmpeq_epi64(keys, _mm256_set1_epi64x(x));
+                mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+            }
+            mask &= candidates;
+            return mask ? __builtin_ctz(mask) : -1;
+        }
+#endif
+        for (; candidates; candidates &= candidates - 1) {
+            int i = __builtin_ctz(candidates);
+            if (b.slot[i].load(std::memory_order_relaxed) == x) return i;
+        }
+        return -1;
+    }
+
+    // Bucket helpers; callers hold the bucket's stripe for the writers
+    static int findKey(const Table* t, int which, int b, const Hashed& k) {
+        unsigned candidates = tagMatches(t->tags[which][b].load(std::memory_order_relaxed), k.tag);
+        if (candidates == 0) return -1;  // the key array is never touched
+        return findSlot(t->bucket[which][b], k.key, candidates);
+    }
+
+    static int freeSlot(const Table* t, int which, int b) {
+        unsigned mask = tagMatches(t->tags[which][b].load(std::memory_order_relaxed), 0);
+        return mask ? __builtin_ctz(mask) : -1;
+    }
+
+    static uint8_t tagAt(const Table* t, int which, int b, int i) {
+        return t->tags[which][b].load(std::memory_order_relaxed) >> (8 * i);
+    }
+
+    // Store x and its tag (EMPTY and 0 to free the slot) into slot i of bucket b
+    static void setSlot(Table* t, int which, int b, int i, T x, uint64_t tag) {
+        uint64_t tags = t->tags[which][b].load(std::memory_order_relaxed);
+        tags = (tags & ~(0xffULL << (8 * i))) | (tag << (8 * i));
+        t->bucket[which][b].slot[i].store(x, std::memory_order_relaxed);
+        t->tags[which][b].store(tags, std::memory_order_relaxed);
+    }
+
+    static Cell& cell(const Table* t, int which, int b, int i) {
+        return t->values[which][(size_t)b * SLOTS + i];
+    }
+
+    // Carry a value along when its key moves; out-of-line values move by
+    // pointer, so the old cell must not be freed
+    static void copyCell(Cell& to, const Cell& from) {
+        if constexpr (!Traits::none) {
+            to.store(from.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+
+    static void moveValue(const Table* from, int fw, int fb, int fi,
+                          const Table* to, int tw, int tb, int ti) {
+        if constexpr (!Traits::none) {
+            copyCell(cell(to, tw, tb, ti), cell(from, fw, fb, fi));
+        }
+    }
+
+    // Stash entry holding k, or -1. Holders of k's stripes may use it, and
+    // so may readers that validate them afterwards.
+    int stashFind(const Hashed& k) const {
+        if (__builtin_expect(stash.count.load(std::memory_order_relaxed) == 0, 1)) return -1;
+        return stashScan(k.key);
+    }
+
+    __attribute__((noinline, cold)) int stashScan(T x) const {
+        for (int j = 0; j < STASH_SIZE; j++) {
+            if (stash.key[j].load(std::memory_order_relaxed) == x) {
+                telemetry.add(TableTelemetry::STASH_HIT);
+                return j;
+            }
+        }
+        return -1;
+    }
+
+    // Park k, with its value from make(cell), in a free stash entry. The
+    // caller holds k's stripes with their versions odd. False if full.
+    template<typename Make>
+    bool stashPut(const Hashed& k, Make& make) {
+        std::lock_guard<std::mutex> lk(stash.lock);
+        for (int j = 0; j < STASH_SIZE; j++) {
+            if (stash.key[j].load(std::memory_order_relaxed) != EMPTY) continue;
+            if constexpr (!Traits::none) make(stash.value[j]);
+            stash.key[j].store(k.key, std::memory_order_relaxed);
+            stash.count.fetch_add(1, std::memory_order_relaxed);
+            telemetry.add(TableTelemetry::STASH_INSERT);
+            return true;
+        }
+        return false;
+    }
+
+    void stashClear(int j) {
+        std::lock_guard<std::mutex> lk(stash.lock);
+        stash.key[j].store(EMPTY, std::memory_order_relaxed);
+        stash.count.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Move stashed keys back into free slots of their buckets, typically
+    // after a resize made room; entries that still do not fit stay
+    void unstash() {
+        for (int j = 0; j < STASH_SIZE; j++) {
+            T x = stash.key[j].load();
+            if (x == EMPTY) continue;
+
+            Hashed k = acquire(x);
+            Table* t = lockedTable(k);
+            if (stash.key[j].load() == x) {
+                for (int w = 0; w < TABLES; w++) {
+                    int b = index(t, w, k);
+                    int i = freeSlot(t, w, b);
+                    if (i < 0) continue;
+                    writeBegin(k);
+                    if constexpr (!Traits::none) copyCell(cell(t, w, b, i), stash.value[j]);
+                    setSlot(t, w, b, i, x, k.tag);
+                    stashClear(j);
+                    writeEnd(k);
+                    break;
+                }
+            }
+            release(k);
+        }
+    }
+
+    // Start loading everything an operation on x will read: its stripe
+    // versions, its tag words and, for writers, its key buckets
+    void prefetch(const LockArray* la, const Table* t, T x, bool keys) const {
+        Hashed k(la->hash, x);
+        for (int w = 0; w < TABLES; w++) {
+            int b = index(t, w, k);
+            __builtin_prefetch(&la->stripe[w][stripeIndex(la, w, k)]);
+            __builtin_prefetch(&t->tags[w][b]);
+            if (keys) __builtin_prefetch(&t->bucket[w][b]);
+        }
+    }
+
+    // A batch call through prefetch() above; writers also prefetch the
+    // stripes they are about to lock
+    template<typename Op>
+    void batch(const T* keys, size_t n, bool* out, bool writes, Op op) {
+        prefetchedBatch<PREFETCH_WINDOW>(epochs, keys, n, out, [&](const T* first, const T* last) {
+            const LockArray* la = locks.load();
+            const Table* t = activeTable();
+            for (; first != last; ++first) prefetch(la, t, *first, writes);
+        }, op);
+    }
+
+    // A bucket reached by the path search, and how it was reached: the key in
+    // slot `slot` of the parent bucket has this bucket as its alternate
+    struct PathNode {
+        int which;
+        int bucket;
+        int parent;  // index into the search queue, -1 for a start bucket
+        int slot;
+        int depth;
+    };
+
+    // Breadth-first search, without locks, from every bucket of x for the
+    // closest bucket with a free slot. Returns its queue index or -1.
+    int searchPath(const Table* t, T x, PathNode* queue) const {
+        int head = 0;
+        int tail = 0;
+        for (int w = 0; w < TABLES; w++) queue[tail++] = {w, index(t, w, x), -1, -1, 0};
+
+        while (head < tail) {
+            int n = head++;
+            if (freeSlot(t, queue[n].which, queue[n].bucket) >= 0) return n;
+            if (queue[n].depth == MAX_PATH) continue;
+
+            // Each key may move to its bucket in any other table
+            const Bucket& b = t->bucket[queue[n].which][queue[n].bucket];
+            for (int s = 0; s < SLOTS && tail < MAX_NODES; s++) {
+                T y = b.slot[s].load(std::memory_order_relaxed);
+                if (y == EMPTY) return n;
+                for (int w = 0; w < TABLES && tail < MAX_NODES; w++) {
+                    if (w != queue[n].which) queue[tail++] = {w, index(t, w, y), n, s, queue[n].depth + 1};
+                }
+            }
+        }
+        return -1;
+    }
+
+    // Make room in one of x's buckets. The displacement path is found by
+    // searchPath() and executed backwards from the free slot, so each hop
+    // moves one key into its alternate bucket while holding only that key's
+    // stripes, and re-validates the hop under them. Returns false if no
+    // path of at most MAX_PATH hops exists; a concurrent change along the
+    // path restarts the search.
+    bool relocate(Table* t, T x) {
+        PathNode queue[MAX_NODES];
+
+        for (int attempt = 0; attempt < MAX_PATH; attempt++) {
+            if (activeTable() != t) return true;  // resized, caller retries
+
+            int n = searchPath(t, x, queue);
+            if (n < 0) {
+                telemetry.add(TableTelemetry::RELOCATE_FAILURE);
+                return false;
+            }
+
+            int hops = queue[n].depth;
+            bool moved = true;
+            for (; queue[n].parent >= 0 && moved; n = queue[n].parent) {
+                const PathNode& to = queue[n];
+                const PathNode& from = queue[to.parent];
+                std::atomic<T>& src = t->bucket[from.which][from.bucket].slot[to.slot];
+                T y = src.load();
+                if (y == EMPTY) continue;  // slot freed under us, hole is here
+
+                Hashed k = acquire(y);
+                int dest = freeSlot(t, to.which, to.bucket);
+                moved = lockedTable(k) == t && src.load() == y &&
+                        index(t, to.which, k) == to.bucket && dest >= 0;
+                if (moved) {
+                    writeBegin(k);
+                    setSlot(t, to.which, to.bucket, dest, y, k.tag);
+                    moveValue(t, from.which, from.bucket, to.slot, t, to.which, to.bucket, dest);
+                    setSlot(t, from.which, from.bucket, to.slot, EMPTY, 0);
+                    writeEnd(k);
+                }
+                release(k);
+            }
+            if (moved) {
+                telemetry.kickPath(hops);
+                return true;
+            }
+        }
+        return true;
+    }
+
+    // The generation writers should use
+    Table* activeTable() const {
+        Table* t = table.load();
+        Table* n = t->next.load();
+        return n ? n : t;
+    }
+
+    // The generation a holder of x's stripes works on. If a resize is in
+    // progress, x's stripes are migrated first.
+    Table* lockedTable(const Hashed& k) {
+        Table* t = table.load();
+        while (Table* n = t->next.load()) {
+            for (int w = 0; w < TABLES; w++) migrate(t, w, stripeIndex(w, k));
+            t = n;
+        }
+        return t;
+    }
+
+    // Move stripe s of table `which` from t into t->next; the caller holds
+    // that stripe. Old bucket b only feeds new buckets b and b + capacity,
+    // which belong to the same stripe, so the copy can never overflow.
+    void migrate(Table* t, int which, int s) {
+        if (t->migrated[which][s].load(std::memory_order_relaxed)) return;
+
+        Table* n = t->next.load();
+        LockArray* la = locks.load();
+        Stripe& st = la->stripe[which][s];
+        writeBegin(st);
+        for (int b = s; b < t->capacity; b += la->capacity) {
+            for (int i = 0; i < SLOTS; i++) {
+                T val = t->bucket[which][b].slot[i].load(std::memory_order_relaxed);
+                if (val != EMPTY) {
+                    int nb = index(n, which, val);
+                    int j = freeSlot(n, which, nb);
+                    setSlot(n, which, nb, j, val, tagAt(t, which, b, i));  // same seed, same tag
+                    moveValue(t, which, b, i, n, which, nb, j);
+                }
+            }
+        }
+        t->migrated[which][s].store(true, std::memory_order_release);
+        writeEnd(st);
+
+        if (t->remaining.fetch_sub(1) == 1) {
+            // Last stripe: publish the new generation
+            table.store(n);
+            epochs.retire(t);  // lock-free readers may still be probing it
+        }
+    }
+
+    // Wait out every current holder of la's stripes; the caller owns the
+    // stripe array, so no new holders appear
+    static void drain(LockArray* la) {
+        for (int w = 0; w < TABLES; w++) {
+            for (int s = 0; s < la->capacity; s++) {
+                la->stripe[w][s].lock.lock();
+                la->stripe[w][s].lock.unlock();
+            }
+        }
+    }
+
+    // Double the stripe array to match a table of `capacity` buckets. The
+    // caller owns the array, so no new holders appear; current holders are
+    // waited out before the old array is retired.
+    void refine(int capacity) {
+        LockArray* old = locks.load();
+        int stripes = capacity / BUCKETS_PER_STRIPE;
+        if (stripes <= old->capacity) return;
+
+        drain(old);
+        locks.store(new LockArray(stripes, old->hash));
+        epochs.retire(old);  // lock-free readers may still hold it
+    }
+
+    // Grow past `expected`, the generation an insert found full. The thread
+    // that starts the doubling refines the stripes and hangs the new
+    // generation off the current one; it then sweeps every stripe not yet
+    // migrated, one stripe lock at a time. Returns false if the table cannot
+    // grow.
+    bool resize(Table* expected) {
+        Table* t = table.load();
+        if (t != expected && t->next.load() != expected) return true;
+
+        uint64_t start = 0;  // set by the thread that starts the doubling
+        if (t->next.load() == nullptr) {
+            if (t->capacity > INT_MAX / 2 / TABLES / SLOTS) return false;
+            const void* none = nullptr;
+            if (!owner.compare_exchange_strong(none, self())) return true;
+
+            if (table.load() == t && t->next.load() == nullptr) {
+                refine(t->capacity * 2);
+                t->stripes = locks.load()->capacity;
+                for (int w = 0; w < TABLES; w++) {
+                    t->migrated[w] = new std::atomic<bool>[t->stripes];
+                    for (int s = 0; s < t->stripes; s++) {
+                        t->migrated[w][s].store(false, std::memory_order_relaxed);
+                    }
+                }
+                t->remaining.store(TABLES * t->stripes);
+                start = Ticks::now();
+                t->next.store(new Table(t->capacity * 2, t->hash));
+            }
+            owner.store(nullptr);
+        }
+
+        // The stripe array cannot be refined again until t is fully
+        // migrated, so an unmigrated stripe is always in the current array
+        for (int w = 0; w < TABLES; w++) {
+            for (int s = 0; s < t->stripes; s++) {
+                if (t->migrated[w][s].load(std::memory_order_acquire)) continue;
+                std::lock_guard<RWSpinLock> lk(locks.load()->stripe[w][s].lock);
+                migrate(t, w, s);
+            }
+        }
+        if (stash.count.load() > 0) unstash();
+        if (start != 0) {
+            telemetry.add(TableTelemetry::RESIZE);
+            telemetry.add(TableTelemetry::RESIZE_TICKS, Ticks::now() - start);
+        }
+        return true;
+    }
+
+    // Put x into t, a table no other thread can reach, with its value
+    // copied in by fill(cell). Same path search as relocate(), but the hops
+    // are made without locks. Returns false if x does not fit.
+    template<typename Fill>
+    bool place(Table* t, T x, Fill fill) {
+        PathNode queue[MAX_NODES];
+        Hashed k(t->hash, x);
+
+        for (int attempt = 0; attempt <= MAX_PATH; attempt++) {
+            for (int w = 0; w < TABLES; w++) {
+                int b = index(t, w, k);
+                int i = freeSlot(t, w, b);
+                if (i >= 0) {
+                    setSlot(t, w, b, i, x, k.tag);
+                    if constexpr (!Traits::none) fill(cell(t, w, b, i));
+                    return true;
+                }
+            }
+
+            int n = searchPath(t, x, queue);
+            if (n < 0) return false;
+            for (; queue[n].parent >= 0; n = queue[n].parent) {
+                const PathNode& to = queue[n];
+                const PathNode& p = queue[to.parent];
+                T y = t->bucket[p.which][p.bucket].slot[to.slot].load(std::memory_order_relaxed);
+                if (y == EMPTY) continue;
+                int dest = freeSlot(t, to.which, to.bucket);
+                if (dest < 0 || index(t, to.which, y) != to.bucket) break;  // path crossed itself
+                setSlot(t, to.which, to.bucket, dest, y, tagAt(t, p.which, p.bucket, to.slot));
+                moveValue(t, p.which, p.bucket, to.slot, t, to.which, to.bucket, dest);
+                setSlot(t, p.which, p.bucket, to.slot, EMPTY, 0);
+            }
+        }
+        return false;
+    }
+
+    // Rebuild `expected`, which an insert found full, at the same capacity
+    // under a new seed. The caller takes ownership of the stripe array and
+    // drains it, so no writer runs while the keys, stashed ones included, are
+    // re-placed into a fresh table; readers keep probing the old one until
+    // the new table and a matching stripe array are published. Returns false, leaving the table
+    // as it was, if it is too full for a re-seed to help, has been re-seeded
+    // MAX_REHASHES times already, or does not fit under the new seed either.
+    bool rehash(Table* expected) {
+        const void* none = nullptr;
+        if (!owner.compare_exchange_strong(none, self())) return true;
+
+        Table* t = table.load();
+        bool done = true;
+        if (t == expected && t->next.load() == nullptr) {
+            uint64_t start = Ticks::now();
+            LockArray* la = locks.load();
+            drain(la);
+            done = false;
+
+            long keys = stash.count.load();
+            for (int w = 0; w < TABLES; w++) {
+                for (int b = 0; b < t->capacity; b++) {
+                    keys += __builtin_popcount(tagMatches(t->tags[w][b].load(std::memory_order_relaxed), 0) ^
+                                               ((1u << SLOTS) - 1));
+                }
+            }
+
+            if (t->rehashes < MAX_REHASHES && keys * 100 < (long)REHASH_LOAD * TABLES * t->capacity * SLOTS) {
+                Table* n = new Table(t->capacity, Hash(mixSeed(t->hash.seed())));
+                n->rehashes = t->rehashes + 1;
+                done = true;
+                for (int w = 0; w < TABLES && done; w++) {
+                    for (int b = 0; b < t->capacity && done; b++) {
+                        for (int i = 0; i < SLOTS && done; i++) {
+                            T val = t->bucket[w][b].slot[i].load(std::memory_order_relaxed);
+                            if (val != EMPTY) {
+                                done = place(n, val, [&](Cell& c) { copyCell(c, cell(t, w, b, i)); });
+                            }
+                        }
+                    }
+                }
+                for (int j = 0; j < STASH_SIZE && done; j++) {
+                    T val = stash.key[j].load(std::memory_order_relaxed);
+                    if (val != EMPTY) {
+                        done = place(n, val, [&](Cell& c) { copyCell(c, stash.value[j]); });
+                    }
+                }
+
+                if (done) {
+                    table.store(n);
+                    locks.store(new LockArray(la->capacity, n->hash));
+                    // Readers that saw the old stripe array will retry, so
+                    // the stash can be emptied now that n holds its keys
+                    for (int j = 0; j < STASH_SIZE; j++) {
+                        if (stash.key[j].load(std::memory_order_relaxed) != EMPTY) stashClear(j);
+                    }
+                    epochs.retire(t);  // lock-free readers may still be probing them
+                    epochs.retire(la);
+                    telemetry.add(TableTelemetry::RESEED);
+                    telemetry.add(TableTelemetry::RESEED_TICKS, Ticks::now() - start);
+                } else {
+                    delete n;  // its out-of-line values are still owned by t
+                }
+            }
+            if (!done) t->rehashes = MAX_REHASHES;  // grow from now on
+        }
+        owner.store(nullptr);
+        return done;
+    }
+
+    // Where k is, for a reader of all its stripes that loaded table t
+    // after la: the generation, table and bucket it sits in and its slot, or
+    // -1. Mid-resize each bucket is read from whichever generation currently
+    // owns its stripe.
+    static int locate(const LockArray* la, const Table* t, const Hashed& k,
+                      const Table*& g, int& which, int& b) {
+        const Table* n = t->next.load(std::memory_order_acquire);
+        for (which = 0; which < TABLES; which++) {
+            g = t;
+            if (n && t->migrated[which][stripeIndex(la, which, k)].load(std::memory_order_acquire)) g = n;
+            b = index(g, which, k);
+            int i = findKey(g, which, b, k);
+            if (i >= 0) return i;
+        }
+        return -1;
+    }
+
+    // Look x up and pass its value cell to read (nullptr: membership only).
+    // Keys and inline values are read optimistically, retried only if a
+    // writer touched one of x's stripes or the stripe array was refined;
+    // out-of-line values are read under x's stripes so the pointer cannot be
+    // freed underneath.
+    template<typename Read>
+    bool probe(T x, Read read) const {
+        constexpr bool membership = std::is_null_pointer<Read>::value;
+        if (x == EMPTY) return false;
+        auto pinned = epochs.pin();
+
+        if constexpr (!membership && !Traits::inlined) {
+            Hashed k = acquire(x, true);
+            const Table* g;
+            int w, b;
+            int i = locate(locks.load(), table.load(), k, g, w, b);
+            int j = (i < 0) ? stashFind(k) : -1;
+            if (i >= 0) read(cell(g, w, b, i));
+            else if (j >= 0) read(stash.value[j]);
+            release(k, true);
+            return i >= 0 || j >= 0;
+        } else {
+            while (true) {
+                // The stripe array is read before the table, so a snapshot is
+                // never newer than the migrated flags it indexes
+                const LockArray* la = locks.load(std::memory_order_acquire);
+                Hashed k(la->hash, x);
+                const Stripe* st[TABLES];
+                unsigned v[TABLES];
+                unsigned odd = 0;
+                for (int w = 0; w < TABLES; w++) {
+                    st[w] = &la->stripe[w][stripeIndex(la, w, k)];
+                    v[w] = st[w]->version.load(std::memory_order_acquire);
+                    odd |= v[w];
+                }
+                if (odd & 1) {
+                    cpuRelax();
+                    continue;
+                }
+
+                // A re-seed publishes the table just before its stripe array
+                const Table* t = table.load(std::memory_order_acquire);
+                if (t->hash.seed() != la->hash.seed()) continue;
+
+                const Table* g;
+                int w, b;
+                int i = locate(la, t, k, g, w, b);
+                int j = (i < 0) ? stashFind(k) : -1;
+                if constexpr (!membership) {
+                    if (i >= 0) read(cell(g, w, b, i));
+                    else if (j >= 0) read(stash.value[j]);
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                bool unchanged = locks.load(std::memory_order_relaxed) == la;
+                for (int w = 0; w < TABLES; w++) {
+                    unchanged &= st[w]->version.load(std::memory_order_relaxed) == v[w];
+                }
+                if (unchanged) return i >= 0 || j >= 0;
+            }
+        }
+    }
+
+    // Insert x unless it is present. make(cell) fills in the new slot's
+    // value; if x is already there, visit(cell) runs on its value under x's
+    // stripes with their versions odd (nullptr leaves it alone). Returns true
+    // if x was inserted.
+    template<typename Visit, typename Make>
+    bool insertOrVisit(T x, Visit visit, Make make) {
+        if (x == EMPTY) return false;
+        auto pinned = epochs.pin();
+
+        bool overflow = false;  // no cuckoo path: x may go to the stash
+        while (true) {
+            Hashed k = acquire(x);
+            Table* t = lockedTable(k);
+            int bucket[TABLES];
+            int w = 0;
+            int i = -1;
+            for (; w < TABLES; w++) {
+                bucket[w] = index(t, w, k);
+                i = findKey(t, w, bucket[w], k);
+                if (i >= 0) break;
+            }
+            int b = (i >= 0) ? bucket[w] : 0;
+            int j = (i < 0) ? stashFind(k) : -1;
+            if (i >= 0 || j >= 0) {
+                if constexpr (!std::is_null_pointer<Visit>::value) {
+                    writeBegin(k);
+                    visit(i >= 0 ? cell(t, w, b, i) : stash.value[j]);
+                    writeEnd(k);
+                }
+                release(k);
+                return false;
+            }
+            for (w = 0; w < TABLES; w++) {
+                i = freeSlot(t, w, bucket[w]);
+                if (i >= 0) break;
+            }
+            if (i >= 0) {
+                b = bucket[w];
+                writeBegin(k);
+                if constexpr (!Traits::none) make(cell(t, w, b, i));
+                setSlot(t, w, b, i, x, k.tag);
+                writeEnd(k);
+                counts.add(1);
+                release(k);
+                return true;
+            }
+            if (overflow) {
+                writeBegin(k);
+                bool stashed = stashPut(k, make);
+                writeEnd(k);
+                if (stashed) {
+                    counts.add(1);
+                    release(k);
+                    return true;
+                }
+            }
+            release(k);
+
+            // Both buckets full: free a slot along a cuckoo path, failing
+            // that stash x, and grow only once the stash is full too
+            if (relocate(t, x)) continue;
+            if (!overflow) {
+                overflow = true;
+                continue;
+            }
+            if (!rehash(t) && !resize(t)) {
+                return false;
+            }
+            overflow = false;
+        }
+    }
+
+    // Run fn(cell) on x's value under its stripes; false if x is absent
+    template<typename Fn>
+    bool modify(T x, Fn fn) {
+        if (x == EMPTY) return false;
+        auto pinned = epochs.pin();
+
+        Hashed k = acquire(x);
+        Table* t = lockedTable(k);
+        for (int w = 0; w < TABLES; w++) {
+            int b = index(t, w, k);
+            int i = findKey(t, w, b, k);
+            if (i >= 0) {
+                writeBegin(k);
+                fn(cell(t, w, b, i));
+                writeEnd(k);
+                release(k);
+                return true;
+            }
+        }
+        int j = stashFind(k);
+        if (j >= 0) {
+            writeBegin(k);
+            fn(stash.value[j]);
+            writeEnd(k);
+        }
+        release(k);
+        return j >= 0;
+    }
+
+    // Remove x, freeing an out-of-line value
+    bool erase(T x) {
+        if (x == EMPTY) return false;
+        auto pinned = epochs.pin();
+
+        Hashed k = acquire(x);
+        Table* t = lockedTable(k);
+        for (int w = 0; w < TABLES; w++) {
+            int b = index(t, w, k);
+            int i = findKey(t, w, b, k);
+            if (i >= 0) {
+                writeBegin(k);
+                setSlot(t, w, b, i, EMPTY, 0);
+                writeEnd(k);
+                if constexpr (!Traits::none && !Traits::inlined) {
+                    delete cell(t, w, b, i).load(std::memory_order_relaxed);
+                }
+                counts.add(-1);
+                release(k);
+                return true;
+            }
+        }
+        int j = stashFind(k);
+        if (j >= 0) {
+            // Take the value before the entry can be reused
+            Cell value;
+            copyCell(value, stash.value[j]);
+            writeBegin(k);
+            stashClear(j);
+            writeEnd(k);
+            if constexpr (!Traits::none && !Traits::inlined) {
+                delete value.load(std::memory_order_relaxed);
+            }
+        }
+        if (j >= 0) counts.add(-1);
+        release(k);
+        return j >= 0;
+    }
+
+    // Run fn(w) for w in [0, workers), one thread each, the caller taking w = 0
+    template<typename Fn>
+    static void runWorkers(size_t workers, Fn fn) {
+        std::vector<std::thread> pool;
+        for (size_t w = 1; w < workers; w++) pool.emplace_back(fn, w);
+        fn(0);
+        for (std::thread& t : pool) t.join();
+    }
+
+    // Insert keys[0, n) from every core. The table is grown up front to keep
+    // it below BULK_LOAD percent, then the keys are hashed in parallel and
+    // handed to the worker owning their table-0 stripe; worker w owns stripes
+    // [w, w + 1) * capacity / workers of every table. Each worker stores its
+    // keys without locks into free slots of its own buckets: the table-0
+    // bucket, or another table's bucket whose stripe it also owns. Keys that
+    // need another worker's bucket or a cuckoo path go through the locked
+    // insert afterwards, still in parallel. Nothing else may use the table
+    // meanwhile.
+    void bulkInsert(const T* keys, size_t n) {
+        static_assert(Traits::none, "bulk loading is for sets");
+        auto pinned = epochs.pin();
+        long target = (long)size() + (long)n;
+        while ((long)getCapacity() * BULK_LOAD < target * 100 && resize(table.load())) {}
+
+        Table* t = table.load();
+        const LockArray* la = locks.load();
+        size_t workers = std::min<size_t>({std::max(1u, std::thread::hardware_concurrency()),
+                                           (size_t)la->capacity, n / BULK_CHUNK + 1});
+        auto ownerOf = [&](int s) { return (size_t)s * workers / la->capacity; };
+
+        // outbox[from][to]: keys hashed by worker `from` for worker `to`
+        std::vector<std::vector<std::vector<Hashed>>> outbox(workers, std::vector<std::vector<Hashed>>(workers));
+        runWorkers(workers, [&](size_t w) {
+            for (size_t i = n * w / workers; i < n * (w + 1) / workers; i++) {
+                if (keys[i] == EMPTY) continue;
+                Hashed k(la->hash, keys[i]);
+                outbox[w][ownerOf(stripeIndex(la, 0, k))].push_back(k);
+            }
+        });
+
+        // A worker only writes buckets it owns, and a key is only handled by
+        // one worker, so reading another worker's bucket for k cannot miss k
+        std::vector<std::vector<T>> leftover(workers);
+        runWorkers(workers, [&](size_t w) {
+            long added = 0;
+            for (size_t from = 0; from < workers; from++) {
+                for (const Hashed& k : outbox[from][w]) {
+                    int bucket[TABLES];
+                    bool present = stashFind(k) >= 0;
+                    for (int u = 0; u < TABLES && !present; u++) {
+                        bucket[u] = index(t, u, k);
+                        present = findKey(t, u, bucket[u], k) >= 0;
+                    }
+                    if (present) continue;
+
+                    int u = 0;
+                    int i = -1;
+                    for (; u < TABLES; u++) {
+                        if (u > 0 && ownerOf(stripeIndex(la, u, k)) != w) continue;
+                        i = freeSlot(t, u, bucket[u]);
+                        if (i >= 0) break;
+                    }
+                    if (i >= 0) {
+                        setSlot(t, u, bucket[u], i, k.key, k.tag);
+                        added++;
+                    } else {
+                        leftover[w].push_back(k.key);
+                    }
+                }
+                std::vector<Hashed>().swap(outbox[from][w]);
+            }
+            counts.add(added);
+        });
+
+        runWorkers(workers, [&](size_t w) {
+            for (T x : leftover[w]) insertOrVisit(x, nullptr, nullptr);
+        });
+    }
+
+    // Offset and length of a snapshot's sections for tables of `capacity`
+    // buckets: every bucket array, every tag array, then the stash keys
+    static const int SECTIONS = 2 * TABLES + 1;
+
+    static void snapshotLayout(int64_t capacity, size_t* offset, size_t* bytes) {
+        for (int i = 0; i < SECTIONS; i++) {
+            offset[i] = i ? Snapshot::alignUp(offset[i - 1] + bytes[i - 1]) : Snapshot::DATA_OFFSET;
+            bytes[i] = (i < TABLES) ? capacity * sizeof(Bucket)
+                     : (i < 2 * TABLES) ? capacity * sizeof(uint64_t) : STASH_SIZE * sizeof(T);
+        }
+    }
+
+    static void snapshotFingerprint(const Hash& hash, uint64_t* fingerprint) {
+        for (int w = 0; w < TABLES; w++) fingerprint[w] = hash(Snapshot::PROBE_KEY, w);
+    }
+
+    // Write the table to path. Like exactSize(), the stripe array is owned,
+    // a resize in progress is finished, and every stripe is locked while the
+    // arrays are written, so the snapshot is one consistent state.
+    bool saveTo(const std::string& path) {
+        static_assert(Traits::none, "snapshots hold keys only");
+        static_assert(TABLES <= Snapshot::MAX_FUNCTIONS, "header holds one fingerprint per table");
+        auto pinned = epochs.pin();
+        const void* none = nullptr;
+        while (!owner.compare_exchange_weak(none, self())) {
+            none = nullptr;
+            cpuRelax();
+        }
+        for (Table* t = table.load(); t->next.load() != nullptr; t = table.load()) resize(t);
+
+        LockArray* la = locks.load();
+        for (int w = 0; w < TABLES; w++) {
+            for (int s = 0; s < la->capacity; s++) la->stripe[w][s].lock.lock_shared();
+        }
+
+        Table* t = table.load();
+        Snapshot::Header h = {};
+        std::copy(Snapshot::MAGIC, Snapshot::MAGIC + sizeof(h.magic), h.magic);
+        h.version = Snapshot::VERSION;
+        h.keyBytes = sizeof(T);
+        h.slots = SLOTS;
+        h.functions = TABLES;
+        h.capacity = t->capacity;
+        h.stripes = la->capacity;
+        h.seed = t->hash.seed();
+        snapshotFingerprint(t->hash, h.fingerprint);
+        h.keys = size();
+
+        size_t offset[SECTIONS], bytes[SECTIONS];
+        snapshotLayout(t->capacity, offset, bytes);
+        const void* section[SECTIONS];
+        for (int w = 0; w < TABLES; w++) {
+            section[w] = t->bucket[w];
+            section[TABLES + w] = t->tags[w];
+        }
+        section[SECTIONS - 1] = stash.key;
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        for (int i = 0; i < SECTIONS && out; i++) {
+            out.seekp(offset[i]);  // gaps read back as zeros
+            out.write(static_cast<const char*>(section[i]), bytes[i]);
+        }
+        out.close();
+        bool ok = !out.fail();
+
+        for (int w = 0; w < TABLES; w++) {
+            for (int s = 0; s < la->capacity; s++) la->stripe[w][s].lock.unlock_shared();
+        }
+        owner.store(nullptr);
+        return ok;
+    }
+
+    // Replace the contents with the snapshot at path, using its arrays in
+    // place. Nothing else may use the table meanwhile. Returns false, leaving
+    // the table as it was, if the file is missing, truncated, from another
+    // key or bucket layout, or hashed differently from what this Hash
+    // computes under the recorded seed.
+    bool loadFrom(const std::string& path) {
+        static_assert(Traits::none, "snapshots hold keys only");
+        size_t bytes = 0;
+        void* p = Snapshot::map(path, bytes);
+        if (p == nullptr) return false;
+
+        const Snapshot::Header& h = *static_cast<const Snapshot::Header*>(p);
+        Hash hash(h.seed);
+        uint64_t fingerprint[TABLES];
+        snapshotFingerprint(hash, fingerprint);
+        size_t offset[SECTIONS], length[SECTIONS];
+        bool valid = bytes >= Snapshot::DATA_OFFSET &&
+                     std::equal(Snapshot::MAGIC, Snapshot::MAGIC + sizeof(h.magic), h.magic) &&
+                     h.version == Snapshot::VERSION && h.keyBytes == sizeof(T) &&
+                     h.slots == SLOTS && h.functions == TABLES &&
+                     h.capacity > 0 && h.capacity <= INT_MAX / TABLES / SLOTS &&
+                     (h.capacity & (h.capacity - 1)) == 0 &&
+                     h.stripes > 0 && h.stripes <= h.capacity && (h.stripes & (h.stripes - 1)) == 0 &&
+                     std::equal(fingerprint, fingerprint + TABLES, h.fingerprint);
+        if (valid) {
+            snapshotLayout(h.capacity, offset, length);
+            valid = offset[SECTIONS - 1] + length[SECTIONS - 1] <= bytes;
+        }
+        if (!valid) {
+            Snapshot::unmap(p, bytes);
+            return false;
+        }
+
+        const T* stashed = reinterpret_cast<const T*>(static_cast<char*>(p) + offset[SECTIONS - 1]);
+        int n = 0;
+        for (int j = 0; j < STASH_SIZE; j++) {
+            stash.key[j].store(stashed[j], std::memory_order_relaxed);
+            if (stashed[j] != EMPTY) n++;
+        }
+        stash.count.store(n);
+        counts.reset(h.keys);
+
+        delete table.load();
+        delete locks.load();
+        locks.store(new LockArray(h.stripes, hash));
+        table.store(new Table(h.capacity, hash, p, bytes, offset));
+        return true;
+    }
+
+    // initialCapacity is the number of keys the tables can hold
+    StripedCuckooTable(int initialCapacity, uint64_t seed) {
+        int buckets = roundUpPow2((initialCapacity + TABLES * SLOTS - 1) / (TABLES * SLOTS));
+        Hash hash(seed);
+        table.store(new Table(buckets, hash));
+        locks.store(new LockArray(buckets >= BUCKETS_PER_STRIPE ? buckets / BUCKETS_PER_STRIPE : 1, hash));
+    }
+
+    ~StripedCuckooTable() {
+        // Only the live generation owns out-of-line values; older ones hold
+        // copies of the pointers
+        Table* live = table.load();
+        if constexpr (!Traits::none && !Traits::inlined) {
+            for (int w = 0; w < TABLES; w++) {
+                for (int b = 0; b < live->capacity; b++) {
+                    for (int i = 0; i < SLOTS; i++) {
+                        if (live->bucket[w][b].slot[i].load(std::memory_order_relaxed) != EMPTY) {
+                            delete cell(live, w, b, i).load(std::memory_order_relaxed);
+                        }
+                    }
+                }
+            }
+            for (int j = 0; j < STASH_SIZE; j++) {
+                if (stash.key[j].load(std::memory_order_relaxed) != EMPTY) {
+                    delete stash.value[j].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        delete live;
+        delete locks.load();
+    }
+
+public:
+    StripedCuckooTable(const StripedCuckooTable&) = delete;
+    StripedCuckooTable& operator=(const StripedCuckooTable&) = delete;
+
+    // Number of keys; exact when no writer is running, otherwise within the
+    // operations in flight
+    int size() const {
+        return counts.total();
+    }
+
+    // Number of keys at one instant: the stripe array is owned, so nothing
+    // is resized or re-seeded, and every stripe is locked at once. Stops all
+    // writers while it runs, so it is meant for occasional use.
+    int exactSize() {
+        auto pinned = epochs.pin();
+        const void* none = nullptr;
+        while (!owner.compare_exchange_weak(none, self())) {
+            none = nullptr;
+            cpuRelax();
+        }
+        LockArray* la = locks.load();
+        for (int w = 0; w < TABLES; w++) {
+            for (int s = 0; s < la->capacity; s++) la->stripe[w][s].lock.lock_shared();
+        }
+        int n = size();
+        for (int w = 0; w < TABLES; w++) {
+            for (int s = 0; s < la->capacity; s++) la->stripe[w][s].lock.unlock_shared();
+        }
+        owner.store(nullptr);
+        return n;
+    }
+
+    // Kicks, stash use, resizes and lock waits so far, summed over threads
+    TableCounters counters() const {
+        return telemetry.totals();
+    }
+
+    // Number of keys the tables can hold
+    int getCapacity() const {
+        auto pinned = epochs.pin();
+        return TABLES * table.load()->capacity * SLOTS;
+    }
+
+    // Bytes held by the set itself, its live generations and stripes; out-of-
+    // line map values are not included
+    size_t memoryBytes() const {
+        auto pinned = epochs.pin();
+        size_t bytes = sizeof(*this) + TABLES * locks.load()->capacity * sizeof(Stripe);
+        for (const Table* t = table.load(); t != nullptr; t = t->next.load()) {
+            size_t perBucket = sizeof(Bucket) + sizeof(uint64_t);
+            if constexpr (!Traits::none) perBucket += SLOTS * sizeof(Cell);
+            bytes += sizeof(Table) + (size_t)TABLES * t->capacity * perBucket;
+        }
+        return bytes;
+    }
+};
+
+template<typename T, int SLOTS = 8, typename Hash = MurmurHash, typename Alloc = HeapAlloc, int TABLES = 2>
+class StripedCuckooHashSet : public StripedCuckooTable<T, NoValue, SLOTS, Hash, Alloc, TABLES> {
+private:
+    using Base = StripedCuckooTable<T, NoValue, SLOTS, Hash, Alloc, TABLES>;
+
+public:
+    StripedCuckooHashSet(int initialCapacity, uint64_t seed = 714) : Base(initialCapacity, seed) {}
+
+    bool add(T x) {
+        return this->insertOrVisit(x, nullptr, nullptr);
+    }
+
+    bool remove(T x) {
+        return this->erase(x);
+    }
+
+    bool contains(T x) const {
+        return this->probe(x, nullptr);
+    }
+
+    // Batched forms: out[i] receives the result for keys[i]. Lookups for a
+    // window of keys are prefetched together to hide DRAM latency.
+    void contains_batch(const T* keys, size_t n, bool* out) {
+        this->batch(keys, n, out, false, [this](T x) { return contains(x); });
+    }
+
+    void add_batch(const T* keys, size_t n, bool* out) {
+        this->batch(keys, n, out, true, [this](T x) { return add(x); });
+    }
+
+    void remove_batch(const T* keys, size_t n, bool* out) {
+        this->batch(keys, n, out, true, [this](T x) { return remove(x); });
+    }
+
+    // Insert [first, last) using every core; must not run concurrently with
+    // any other operation on the set
+    template<typename It>
+    void bulk_load(It first, It last) {
+        std::vector<T> keys(first, last);
+        this->bulkInsert(keys.data(), keys.size());
+    }
+
+    // Snapshot the set to a file, consistent even under concurrent writers
+    // (which wait meanwhile); false on an I/O error
+    bool save(const std::string& path) {
+        return this->saveTo(path);
+    }
+
+    // Restore a snapshot written by save(), mapping the file instead of
+    // reinserting its keys; must not run concurrently with any other
+    // operation. False, with the set unchanged, if the file is unusable.
+    bool load(const std::string& path) {
+        return this->loadFrom(path);
+    }
+
+    void populate(int count) {  // Non-thread safe
+        std::mt19937 gen(714);  // Fixed seed
+        std::uniform_int_distribution<> dis(1, INT_MAX);
+
+        // Bulk load the first `count` draws, then top up duplicates from the
+        // same sequence: the same keys a one-at-a-time loop would add
+        std::vector<T> keys(count);
+        for (T& k : keys) k = dis(gen);
+        int before = this->size();
+        bulk_load(keys.begin(), keys.end());
+
+        int added = this->size() - before;
+        int attempts = count;
+        while (added < count && attempts < count * 3) {
+            int val = dis(gen);
+            if (add(val)) {
+                added++;
+            }
+            attempts++;
+        }
+    }
+};
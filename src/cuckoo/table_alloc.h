@@ -0,0 +1,149 @@
+// Allocation policies for the striped cuckoo table's arrays (striped_cuckoo.h).
+//
+// Buckets, tags and stripes are probed at random, so once a table outgrows
+// the TLB's reach nearly every probe is also a TLB miss. HugePageAlloc maps
+// large arrays with 2 MiB pages, which lets the same TLB cover 512 times as
+// much table, and can interleave them across NUMA nodes. It also constructs
+// each array from several threads: that first touch faults the pages in (and,
+// without interleaving, places each on the toucher's node) up front and in
+// parallel, instead of inside timed operations or all on the resizing thread.
+//
+// A policy hands out n value-initialized objects and takes them back:
+//   template<typename U> static U* allocate(size_t n);
+//   template<typename U> static void deallocate(U* p, size_t n);
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Plain new[]/delete[]
+struct HeapAlloc {
+    template<typename U>
+    static U* allocate(size_t n) {
+        return new U[n]();
+    }
+
+    template<typename U>
+    static void deallocate(U* p, size_t) {
+        delete[] p;
+    }
+};
+
+// Arrays of at least one huge page are mmap'ed: explicit huge pages if any
+// are reserved, else transparent huge pages, else (THP disabled) ordinary
+// pages. Smaller arrays come from the heap. With INTERLEAVE, large arrays are
+// spread page by page over every online NUMA node when there are several.
+template<bool INTERLEAVE = false>
+class HugePageAlloc {
+public:
+    static const size_t HUGE_PAGE = 2 << 20;
+
+    template<typename U>
+    static U* allocate(size_t n) {
+#ifdef __linux__
+        size_t bytes = n * sizeof(U);
+        if (bytes >= HUGE_PAGE) {
+            U* p = static_cast<U*>(map(roundUp(bytes)));
+            construct(p, n);
+            return p;
+        }
+#endif
+        return HeapAlloc::allocate<U>(n);
+    }
+
+    template<typename U>
+    static void deallocate(U* p, size_t n) {
+#ifdef __linux__
+        size_t bytes = n * sizeof(U);
+        if (bytes >= HUGE_PAGE) {
+            if (p == nullptr) return;
+            for (size_t i = 0; i < n; i++) p[i].~U();
+            munmap(p, roundUp(bytes));
+            return;
+        }
+#endif
+        HeapAlloc::deallocate(p, n);
+    }
+
+private:
+    static size_t roundUp(size_t bytes) {
+        return (bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+    }
+
+#ifdef __linux__
+    static void* map(size_t len) {
+        void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED) {
+            // No reserved huge pages. Over-map so the range can be trimmed to
+            // a huge page boundary, where THP can back it with huge pages.
+            char* raw = static_cast<char*>(mmap(nullptr, len + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+            if (raw == MAP_FAILED) throw std::bad_alloc();
+            char* start = reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(raw)));
+            if (start > raw) munmap(raw, start - raw);
+            munmap(start + len, raw + HUGE_PAGE - start);
+            madvise(start, len, MADV_HUGEPAGE);
+            p = start;
+        }
+        if (INTERLEAVE) interleave(p, len);
+        return p;
+    }
+
+    // Best effort: the default policy stays if mbind is unavailable
+    static void interleave(void* p, size_t len) {
+        unsigned long nodes = onlineNodes();
+        if (__builtin_popcountl(nodes) < 2) return;
+        syscall(SYS_mbind, p, len, MPOL_INTERLEAVE, &nodes, sizeof(nodes) * 8 + 1, 0);
+    }
+
+    // Bitmask of the online nodes below 64, from e.g. "0-3" or "0,2"
+    static unsigned long onlineNodes() {
+        std::ifstream in("/sys/devices/system/node/online");
+        std::string list;
+        if (!(in >> list)) return 1;
+
+        unsigned long mask = 0;
+        size_t pos = 0;
+        while (pos < list.size()) {
+            size_t end = list.find(',', pos);
+            if (end == std::string::npos) end = list.size();
+            std::string range = list.substr(pos, end - pos);
+            size_t dash = range.find('-');
+            int lo = std::stoi(range.substr(0, dash));
+            int hi = (dash == std::string::npos) ? lo : std::stoi(range.substr(dash + 1));
+            for (int node = lo; node <= hi && node < 64; node++) mask |= 1UL << node;
+            pos = end + 1;
+        }
+        return mask;
+    }
+
+    // Value-initialize p[0, n), one contiguous chunk per hardware thread
+    template<typename U>
+    static void construct(U* p, size_t n) {
+        size_t pages = n * sizeof(U) / HUGE_PAGE;
+        size_t workers = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), pages));
+        size_t chunk = (n + workers - 1) / workers;
+
+        auto fill = [p, n, chunk](size_t w) {
+            for (size_t i = w * chunk; i < std::min(n, (w + 1) * chunk); i++) new (p + i) U();
+        };
+        std::vector<std::thread> pool;
+        for (size_t w = 1; w < workers; w++) pool.emplace_back(fill, w);
+        fill(0);
+        for (std::thread& t : pool) t.join();
+    }
+#endif
+};
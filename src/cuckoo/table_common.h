@@ -0,0 +1,68 @@
+// Pieces every set engine shares: its key count, power-of-two rounding of
+// table sizes, and the windowed prefetch loop behind the batch calls.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include "epoch.h"
+
+// Smallest power of two that is at least n
+template<typename N>
+static inline N roundUpPow2(N n) {
+    N p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+// Net keys added to a table, split over SHARDS counters on cache lines of
+// their own. A thread picks its counter once, so writers never contend on a
+// shared line; a reader sums them.
+class KeyCounter {
+    static const int SHARDS = 64;
+
+public:
+    void add(long delta) {
+        shards[shardOf()].n.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    // Exact when no writer is running, otherwise within the writes in flight
+    long total() const {
+        long n = 0;
+        for (const Shard& s : shards) n += s.n.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    // Start over from n keys; only while no writer is running
+    void reset(long n) {
+        for (Shard& s : shards) s.n.store(0, std::memory_order_relaxed);
+        add(n);
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<long> n{0};
+    };
+
+    static int shardOf() {
+        static std::atomic<int> next{0};
+        static thread_local int shard = next.fetch_add(1) % SHARDS;
+        return shard;
+    }
+
+    Shard shards[SHARDS];
+};
+
+// Run op over keys[0, n) in windows of WINDOW keys, each under one pin of
+// epochs: prefetch(first, last) starts loading the window's buckets so
+// their cache misses overlap, then op resolves the keys one by one and
+// out[i] receives its result for keys[i]. The ops nest in the window's pin.
+template<size_t WINDOW, typename T, typename Prefetch, typename Op>
+void prefetchedBatch(EpochDomain& epochs, const T* keys, size_t n, bool* out, Prefetch prefetch, Op op) {
+    for (size_t base = 0; base < n; base += WINDOW) {
+        size_t end = std::min(n, base + WINDOW);
+        auto pinned = epochs.pin();
+        prefetch(keys + base, keys + end);
+        for (size_t i = base; i < end; i++) out[i] = op(keys[i]);
+    }
+}
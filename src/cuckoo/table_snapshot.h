@@ -0,0 +1,79 @@
+// On-disk snapshots of the striped cuckoo set (striped_cuckoo.h).
+//
+// A snapshot is a header page followed by the table's raw arrays: every
+// bucket array, every tag array and the stash keys, each section starting
+// on a 64-byte boundary. Loading maps the file copy-on-write and uses the
+// arrays in place, so a restart pages the table in instead of rehashing
+// every key; pages are only copied once a writer touches them.
+//
+// Keys only make sense under the hash they were placed with, so the header
+// records the seed along with what the hash policy computes for a probe key
+// under it. A snapshot written with another policy, or one whose hashing
+// has since changed, is rejected rather than loaded into the wrong buckets.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct Snapshot {
+    static constexpr char MAGIC[8] = {'C', 'U', 'C', 'K', 'O', 'O', 'S', 'T'};
+    static const uint32_t VERSION = 2;
+    static const int MAX_FUNCTIONS = 4;
+    static const size_t DATA_OFFSET = 4096;  // arrays start on a page boundary
+    static const size_t ALIGN = 64;
+    static const uint64_t PROBE_KEY = 0x9e3779b97f4a7c15ULL;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t keyBytes;     // sizeof(T)
+        uint32_t slots;        // SLOTS
+        uint32_t functions;    // hash functions, one table each
+        int64_t capacity;      // buckets per table
+        int64_t stripes;       // lock stripes per table
+        uint64_t seed;
+        uint64_t fingerprint[MAX_FUNCTIONS];  // hash(PROBE_KEY, w) under seed
+        int64_t keys;          // keys in the tables and the stash
+    };
+
+    static size_t alignUp(size_t n) {
+        return (n + ALIGN - 1) & ~(ALIGN - 1);
+    }
+
+    // Map path privately (writes stay in memory); nullptr if it cannot be
+    // opened or mapped
+    static void* map(const std::string& path, size_t& bytes) {
+#ifdef __linux__
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+        struct stat st;
+        void* p = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            bytes = st.st_size;
+            p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);  // the mapping keeps the file alive
+        return p == MAP_FAILED ? nullptr : p;
+#else
+        (void)path;
+        (void)bytes;
+        return nullptr;
+#endif
+    }
+
+    static void unmap(void* p, size_t bytes) {
+#ifdef __linux__
+        munmap(p, bytes);
+#else
+        (void)p;
+        (void)bytes;
+#endif
+    }
+};
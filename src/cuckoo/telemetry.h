@@ -0,0 +1,199 @@
+// Measurement support for the cuckoo tables and their benchmark driver: a
+// cheap tick clock, per-thread latency histograms and per-thread counters of
+// what the table does internally.
+//
+// Everything here is written by one thread and only read once the writers
+// are done, so recording is a plain increment with no shared cache lines.
+// Table counters are bumped on slow paths only (a kick, a failed lock
+// attempt, a resize), never on an uncontended operation.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include "epoch.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Time stamp counter where there is one, else the steady clock in ns
+class Ticks {
+public:
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // Ticks to ns, calibrated against the steady clock on first use
+    static double nanos(uint64_t ticks) {
+        static const double perTick = calibrate();
+        return ticks * perTick;
+    }
+
+private:
+    static double calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+        auto start = std::chrono::steady_clock::now();
+        uint64_t first = now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t last = now();
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        return (double)ns.count() / (last - first);
+#else
+        return 1.0;
+#endif
+    }
+};
+
+// Log-linear histogram of Ticks::now() intervals, kept in ticks so recording
+// costs no conversion; pass results through Ticks::nanos(). 16 linear
+// sub-buckets per power of two, so a percentile is off by at most 1/16 of its
+// value. Not thread safe; keep one per thread and merge them once the
+// threads are done.
+class LatencyHistogram {
+    static const int SUB_BITS = 4;
+    static const int SUB = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+public:
+    void record(uint64_t ticks, uint64_t times = 1) {
+        counts[bucketOf(ticks)] += times;
+        total += times;
+        max = std::max(max, ticks);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < BUCKETS; i++) counts[i] += other.counts[i];
+        total += other.total;
+        max = std::max(max, other.max);
+    }
+
+    uint64_t count() const {
+        return total;
+    }
+
+    uint64_t maximum() const {
+        return max;
+    }
+
+    // Upper edge of the bucket holding the q-quantile, q in [0, 1]
+    uint64_t percentile(double q) const {
+        if (total == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t)(q * total + 0.5));
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) return std::min(max, upperEdge(i));
+        }
+        return max;
+    }
+
+private:
+    // Values below SUB get a bucket each; above, the top SUB_BITS + 1 bits
+    static int bucketOf(uint64_t v) {
+        if (v < SUB) return v;
+        int exp = 63 - __builtin_clzll(v);
+        return (exp - SUB_BITS + 1) * SUB + ((v >> (exp - SUB_BITS)) & (SUB - 1));
+    }
+
+    static uint64_t upperEdge(int i) {
+        if (i < SUB) return i;
+        int exp = i / SUB + SUB_BITS - 1;
+        uint64_t low = ((uint64_t)SUB + i % SUB) << (exp - SUB_BITS);
+        return low + (1ull << (exp - SUB_BITS)) - 1;
+    }
+
+    uint64_t counts[BUCKETS] = {};
+    uint64_t total = 0;
+    uint64_t max = 0;
+};
+
+// What a table did internally, summed over threads
+struct TableCounters {
+    static const int PATH_LENGTHS = 6;
+
+    uint64_t kickPaths[PATH_LENGTHS] = {};  // relocations by hops, the last also longer
+    uint64_t relocateFailures = 0;          // inserts that found no cuckoo path
+    uint64_t resizes = 0;
+    double resizeNanos = 0;                 // starting thread, start to end of its sweep
+    uint64_t reseeds = 0;
+    double reseedNanos = 0;
+    uint64_t stashInserts = 0;
+    uint64_t stashHits = 0;                 // stash scans that found their key
+    uint64_t lockWaits = 0;                 // stripe acquisitions that had to wait
+    double lockWaitNanos = 0;
+
+    TableCounters& operator+=(const TableCounters& o) {
+        for (int i = 0; i < PATH_LENGTHS; i++) kickPaths[i] += o.kickPaths[i];
+        relocateFailures += o.relocateFailures;
+        resizes += o.resizes;
+        resizeNanos += o.resizeNanos;
+        reseeds += o.reseeds;
+        reseedNanos += o.reseedNanos;
+        stashInserts += o.stashInserts;
+        stashHits += o.stashHits;
+        lockWaits += o.lockWaits;
+        lockWaitNanos += o.lockWaitNanos;
+        return *this;
+    }
+};
+
+// Per-thread table counters, one cache line each, indexed by ThreadIds
+class TableTelemetry {
+public:
+    enum Event {
+        RELOCATE_FAILURE = TableCounters::PATH_LENGTHS,
+        RESIZE,
+        RESIZE_TICKS,
+        RESEED,
+        RESEED_TICKS,
+        STASH_INSERT,
+        STASH_HIT,
+        LOCK_WAIT,
+        LOCK_WAIT_TICKS,
+        EVENTS
+    };
+
+    // Only the calling thread writes its slot, so no atomic read-modify-write
+    void add(int event, uint64_t n = 1) const {
+        std::atomic<uint64_t>& c = slots[ThreadIds::get()].n[event];
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void kickPath(int hops) const {
+        add(std::min(hops, TableCounters::PATH_LENGTHS - 1));
+    }
+
+    TableCounters totals() const {
+        uint64_t sum[EVENTS] = {};
+        for (int t = 0; t < ThreadIds::limit(); t++) {
+            for (int e = 0; e < EVENTS; e++) sum[e] += slots[t].n[e].load(std::memory_order_relaxed);
+        }
+
+        TableCounters c;
+        std::copy(sum, sum + TableCounters::PATH_LENGTHS, c.kickPaths);
+        c.relocateFailures = sum[RELOCATE_FAILURE];
+        c.resizes = sum[RESIZE];
+        c.resizeNanos = Ticks::nanos(sum[RESIZE_TICKS]);
+        c.reseeds = sum[RESEED];
+        c.reseedNanos = Ticks::nanos(sum[RESEED_TICKS]);
+        c.stashInserts = sum[STASH_INSERT];
+        c.stashHits = sum[STASH_HIT];
+        c.lockWaits = sum[LOCK_WAIT];
+        c.lockWaitNanos = Ticks::nanos(sum[LOCK_WAIT_TICKS]);
+        return c;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> n[EVENTS] = {};
+    };
+
+    mutable Slot slots[ThreadIds::MAX];
+};
@@ -0,0 +1,113 @@
+// Spin-wait helpers, a spin lock that doubles as a seqlock for the tables
+// whose readers never lock, and a compact striped table of such locks.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "table_common.h"
+
+// Spin-wait hint
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// Spin a little, then give the core away: a lock holder that was
+// preempted can only make progress once the waiters stop spinning
+static inline void spinWait(int& spins) {
+    if (++spins < 64) {
+        cpuRelax();
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+// One 32-bit word: bit 0 is held by the writer, the bits above count the
+// changes it made. A reader takes a snapshot with read(), retries while the
+// lock is held, and trusts what it read in between only if validate() finds
+// the word unchanged. A writer that changed nothing unlocks without a bump,
+// so its readers need not retry.
+class VersionLock {
+public:
+    bool try_lock() {
+        unsigned v = word.load(std::memory_order_relaxed);
+        if ((v & 1) || !word.compare_exchange_strong(v, v | 1, std::memory_order_acquire)) return false;
+        std::atomic_thread_fence(std::memory_order_release);  // no write of ours before the lock
+        return true;
+    }
+
+    void lock() {
+        for (int spins = 0; !try_lock(); spinWait(spins)) {
+            while (word.load(std::memory_order_relaxed) & 1) spinWait(spins);
+        }
+    }
+
+    void unlock(bool changed) {
+        unsigned v = word.load(std::memory_order_relaxed);
+        word.store(changed ? v + 1 : v & ~1u, std::memory_order_release);
+    }
+
+    unsigned read() const {
+        return word.load(std::memory_order_acquire);
+    }
+
+    static bool locked(unsigned v) {
+        return v & 1;
+    }
+
+    bool validate(unsigned v) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return word.load(std::memory_order_relaxed) == v;
+    }
+
+private:
+    std::atomic<unsigned> word{0};
+};
+
+// Lock striping with VersionLocks: a power-of-two number of them, packed
+// sixteen to a cache line, where lock i guards every index congruent to i
+// modulo the size. A word per stripe is a tenth of a std::mutex, and since
+// the table is aligned a stripe never straddles two lines.
+class VersionLockTable {
+    static const size_t PER_LINE = 64 / sizeof(VersionLock);
+
+    struct alignas(64) Line {
+        VersionLock lock[PER_LINE];
+    };
+
+public:
+    // At least n locks
+    explicit VersionLockTable(size_t n) : mask(roundUpPow2(n) - 1), lines(new Line[(mask + PER_LINE) / PER_LINE]) {}
+
+    VersionLockTable(const VersionLockTable&) = delete;
+    VersionLockTable& operator=(const VersionLockTable&) = delete;
+
+    ~VersionLockTable() {
+        delete[] lines;
+    }
+
+    // The lock of index i, for any i
+    VersionLock& operator[](size_t i) {
+        i &= mask;
+        return lines[i / PER_LINE].lock[i % PER_LINE];
+    }
+
+    size_t size() const {
+        return mask + 1;
+    }
+
+    size_t bytes() const {
+        return (mask + PER_LINE) / PER_LINE * sizeof(Line);
+    }
+
+private:
+    size_t mask;
+    Line* lines;
+};
@@ -0,0 +1,271 @@
+// Benchmark workloads for the cuckoo drivers: operation mix, key space, key
+// distribution, prefill and lookup hit rate, set by command-line flags.
+//
+//   --mix=C:A:R      percent of contains / add / remove      (80:10:10)
+//   --keys=N         keys are drawn from [1, N]               (INT_MAX)
+//   --dist=D         uniform, zipf[:theta], hotspot[:hot:share] or
+//                    sequential                               (uniform)
+//   --capacity=N     initial capacity of the table            (1000000)
+//   --prefill=F      keys inserted before timing, as a fraction of the
+//                    capacity                                 (0.5)
+//   --hit=H          fraction of lookups aimed at prefilled keys; the rest
+//                    look up keys that are never inserted     (off)
+//
+// Without --hit, lookups draw keys like updates do. zipf ranks keys by
+// popularity with exponent theta (0.99); hotspot sends `share` of the
+// accesses (0.8) to the first `hot` fraction of the keys (0.2); sequential
+// walks the keys in order, each thread from its own offset. With the
+// defaults every thread draws the exact sequence the original drivers drew,
+// and the prefill is the set populate() builds, so results stay comparable.
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+enum class OpType { CONTAINS, ADD, REMOVE };
+
+struct Op {
+    OpType type;
+    int key;
+};
+
+// Zipfian ranks in [0, n), rank 0 the most popular (Gray et al., "Quickly
+// generating billion-record synthetic databases", as in YCSB)
+class ZipfRanks {
+public:
+    ZipfRanks(long n, double theta) : n(n), theta(theta) {
+        double zeta2 = zeta(2, theta);
+        zetaN = zeta(n, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetaN);
+    }
+
+    // Rank for a uniform u in [0, 1)
+    long operator()(double u) const {
+        double uz = u * zetaN;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta)) return std::min(1L, n - 1);
+        return std::min(n - 1, (long)(n * std::pow(eta * u - eta + 1.0, alpha)));
+    }
+
+private:
+    // Sum of i^-theta for i in [1, n]: exact over the first terms, which
+    // dominate, and the integral of the smooth tail beyond them
+    static double zeta(long n, double theta) {
+        const long EXACT = 1 << 20;
+        double sum = 0;
+        for (long i = 1; i <= std::min(n, EXACT); i++) sum += std::pow((double)i, -theta);
+        if (n > EXACT) {
+            sum += (std::pow(n + 0.5, 1.0 - theta) - std::pow(EXACT + 0.5, 1.0 - theta)) / (1.0 - theta);
+        }
+        return sum;
+    }
+
+    long n;
+    double theta;
+    double zetaN;
+    double alpha;
+    double eta;
+};
+
+class Workload {
+public:
+    enum class Dist { UNIFORM, ZIPF, HOTSPOT, SEQUENTIAL };
+
+    int containsPercent = 80;
+    int addPercent = 10;
+    int removePercent = 10;
+    int keySpace = INT_MAX;
+    Dist dist = Dist::UNIFORM;
+    double theta = 0.99;
+    double hotFraction = 0.2;
+    double hotShare = 0.8;
+    int capacity = 1000000;
+    double prefillFraction = 0.5;
+    double hitRate = -1;  // off
+
+    static const char* usage() {
+        return "[--mix=C:A:R] [--keys=N] [--dist=uniform|zipf[:theta]|hotspot[:hot:share]|sequential] "
+               "[--capacity=N] [--prefill=F] [--hit=H]";
+    }
+
+    // Parse the flags in argv[first, argc); throws std::invalid_argument
+    Workload(int argc, char* argv[], int first) {
+        for (int i = first; i < argc; i++) {
+            std::string arg = argv[i];
+            size_t eq = arg.find('=');
+            if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+                throw std::invalid_argument("bad flag " + arg);
+            }
+            std::string name = arg.substr(2, eq - 2);
+            std::vector<std::string> v = split(arg.substr(eq + 1));
+
+            // std::stoi and std::stod also throw std::out_of_range on numbers
+            // too large for their type
+            try {
+                if (name == "mix" && v.size() == 3) {
+                    containsPercent = std::stoi(v[0]);
+                    addPercent = std::stoi(v[1]);
+                    removePercent = std::stoi(v[2]);
+                } else if (name == "keys" && v.size() == 1) {
+                    keySpace = std::stoi(v[0]);
+                } else if (name == "dist" && v[0] == "uniform" && v.size() == 1) {
+                    dist = Dist::UNIFORM;
+                } else if (name == "dist" && v[0] == "zipf" && v.size() <= 2) {
+                    dist = Dist::ZIPF;
+                    if (v.size() == 2) theta = std::stod(v[1]);
+                } else if (name == "dist" && v[0] == "hotspot" && (v.size() == 1 || v.size() == 3)) {
+                    dist = Dist::HOTSPOT;
+                    if (v.size() == 3) {
+                        hotFraction = std::stod(v[1]);
+                        hotShare = std::stod(v[2]);
+                    }
+                } else if (name == "dist" && v[0] == "sequential" && v.size() == 1) {
+                    dist = Dist::SEQUENTIAL;
+                } else if (name == "capacity" && v.size() == 1) {
+                    capacity = std::stoi(v[0]);
+                } else if (name == "prefill" && v.size() == 1) {
+                    prefillFraction = std::stod(v[0]);
+                } else if (name == "hit" && v.size() == 1) {
+                    hitRate = std::stod(v[0]);
+                } else {
+                    throw std::invalid_argument("bad flag " + arg);
+                }
+            } catch (const std::logic_error&) {
+                throw std::invalid_argument("bad flag " + arg);
+            }
+        }
+
+        if (containsPercent < 0 || addPercent < 0 || removePercent < 0 ||
+            containsPercent + addPercent + removePercent != 100) {
+            throw std::invalid_argument("--mix must be three percentages adding up to 100");
+        }
+        if (keySpace < 1 || capacity < 1) throw std::invalid_argument("--keys and --capacity must be positive");
+        if (theta <= 0 || theta == 1) throw std::invalid_argument("zipf theta must be positive and not 1");
+        if (hotFraction <= 0 || hotFraction > 1 || hotShare < 0 || hotShare > 1) {
+            throw std::invalid_argument("hotspot fractions must lie in (0, 1] and [0, 1]");
+        }
+        if (prefillFraction < 0) throw std::invalid_argument("--prefill must not be negative");
+        if (hitRate > 1) throw std::invalid_argument("--hit must lie in [0, 1]");
+
+        prefill = drawPrefill();
+        if (dist == Dist::ZIPF) {
+            keyZipf.emplace_back(keySpace, theta);
+            if (!prefill.empty()) prefillZipf.emplace_back((long)prefill.size(), theta);
+        }
+    }
+
+    // Distinct keys to insert before timing, in the order populate() would
+    // draw them
+    const std::vector<int>& prefillKeys() const {
+        return prefill;
+    }
+
+    std::string describe() const {
+        static const char* names[] = {"uniform", "zipf", "hotspot", "sequential"};
+        std::ostringstream out;
+        out << "mix=" << containsPercent << ":" << addPercent << ":" << removePercent
+            << " keys=" << keySpace << " dist=" << names[(int)dist];
+        if (dist == Dist::ZIPF) out << ":" << theta;
+        if (dist == Dist::HOTSPOT) out << ":" << hotFraction << ":" << hotShare;
+        out << " capacity=" << capacity << " prefill=" << prefill.size();
+        if (hitRate >= 0) out << " hit=" << hitRate;
+        return out.str();
+    }
+
+    // The operations of one of `threads` worker threads
+    class Stream {
+    public:
+        Stream(const Workload& w, int thread, int threads)
+            : w(w), gen(714 + thread),  // Seed with offset for each thread
+              opDis(1, 100), keyDis(1, w.keySpace),
+              keyCursor((long)w.keySpace * thread / threads),
+              prefillCursor(w.prefill.size() * thread / threads) {}
+
+        Op next() {
+            int operation = opDis(gen);
+            if (operation <= w.containsPercent) {
+                return {OpType::CONTAINS, w.hitRate < 0 ? key() : lookupKey()};
+            } else if (operation <= w.containsPercent + w.addPercent) {
+                return {OpType::ADD, key()};
+            } else {
+                return {OpType::REMOVE, key()};
+            }
+        }
+
+    private:
+        // A key of the key space, drawn from the distribution
+        int key() {
+            if (w.dist == Dist::UNIFORM) return keyDis(gen);
+            return 1 + rank(w.keySpace, w.keyZipf, keyCursor);
+        }
+
+        // A prefilled key with probability hitRate, else one never inserted
+        int lookupKey() {
+            if (real(gen) < w.hitRate && !w.prefill.empty()) {
+                return w.prefill[rank(w.prefill.size(), w.prefillZipf, prefillCursor)];
+            }
+            return -1 - rank(w.keySpace, w.keyZipf, keyCursor);  // inserts are positive
+        }
+
+        long rank(long n, const std::vector<ZipfRanks>& zipf, long& cursor) {
+            switch (w.dist) {
+            case Dist::ZIPF:
+                return zipf[0](real(gen));
+            case Dist::HOTSPOT: {
+                long hot = std::max(1L, std::min(n, (long)(n * w.hotFraction)));
+                if (real(gen) < w.hotShare || hot == n) return (long)(real(gen) * hot);
+                return hot + (long)(real(gen) * (n - hot));
+            }
+            case Dist::SEQUENTIAL:
+                return cursor++ % n;
+            default:
+                return std::min(n - 1, (long)(real(gen) * n));
+            }
+        }
+
+        const Workload& w;
+        std::mt19937 gen;
+        std::uniform_int_distribution<> opDis;
+        std::uniform_int_distribution<> keyDis;
+        std::uniform_real_distribution<double> real;
+        long keyCursor;
+        long prefillCursor;
+    };
+
+private:
+    static std::vector<std::string> split(const std::string& s) {
+        std::vector<std::string> parts;
+        std::istringstream in(s);
+        for (std::string part; std::getline(in, part, ':');) parts.push_back(part);
+        if (parts.empty()) parts.push_back("");
+        return parts;
+    }
+
+    // Same generator, seed and range as populate(), skipping repeats
+    std::vector<int> drawPrefill() {
+        long count = std::min<long>(keySpace, (long)(capacity * prefillFraction));
+        std::vector<int> keys;
+        keys.reserve(count);
+        std::unordered_set<int> seen(count);
+        std::mt19937 gen(714);  // Fixed seed
+        std::uniform_int_distribution<> dis(1, keySpace);
+        while ((long)keys.size() < count) {
+            int key = dis(gen);
+            if (seen.insert(key).second) keys.push_back(key);
+        }
+        return keys;
+    }
+
+    std::vector<int> prefill;
+    std::vector<ZipfRanks> keyZipf;      // over the key space, zipf only
+    std::vector<ZipfRanks> prefillZipf;  // over the prefilled keys, zipf only
+};
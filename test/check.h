@@ -0,0 +1,25 @@
+// Shared by the tests: CHECK reports a condition that does not hold, naming
+// the case under test, and carries on; report() turns the failures into
+// main's exit status.
+#pragma once
+
+#include <iostream>
+
+static int failures = 0;
+
+#define CHECK(name, cond)                                                                              \
+    do {                                                                                               \
+        if (!(cond)) {                                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << (name) << ": failed: " #cond << std::endl; \
+            failures++;                                                                                \
+        }                                                                                              \
+    } while (0)
+
+static int report(const char* suite) {
+    if (failures == 0) {
+        std::cout << suite << ": all checks passed" << std::endl;
+        return 0;
+    }
+    std::cerr << suite << ": " << failures << " checks failed" << std::endl;
+    return 1;
+}
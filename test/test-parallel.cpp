@@ -0,0 +1,172 @@
+// Concurrent tests: every engine of the cuckoo driver (src/cuckoo) under
+// threads that add, remove and look up disjoint keys, each against a local
+// model of its own keys, from a table small enough that it grows meanwhile;
+// and concurrent upserts on shared map keys, with inline and out-of-line
+// values. Build with -DWITH_TBB -ltbb to include the TBB baseline.
+#include <atomic>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "baseline_sets.h"
+#include "benchmark.h"
+#include "cuckoo_map.h"
+#include "delegated_set.h"
+#include "hopscotch_set.h"
+#include "lockfree_cuckoo.h"
+#include "robin_hood_set.h"
+#include "striped_cuckoo.h"
+#include "check.h"
+
+static const int THREADS = 4;
+static const int KEYS = 4096;           // per thread
+static const int OPS = 100000;          // per thread
+static const int BATCH = 8;
+static const int INITIAL_CAPACITY = 64;
+
+using benchmark_detail::addAll;
+using benchmark_detail::containsAll;
+using benchmark_detail::removeAll;
+
+template<typename Set, typename = void>
+struct HasExactSize : std::false_type {};
+
+template<typename Set>
+struct HasExactSize<Set, std::void_t<decltype(std::declval<Set&>().exactSize())>> : std::true_type {};
+
+// Key j of thread t; no two threads share one, and none is 0
+static int keyOf(int t, int j) {
+    return 1 + t + THREADS * j;
+}
+
+// Each thread runs single and batched operations on its own keys and checks
+// every result against its model; then the set's size must equal the sum of
+// the models, and every key must be found exactly when its model has it
+template<typename Set, typename... Options>
+void testEngine(const char* name, Options... options) {
+    Set set(INITIAL_CAPACITY, options...);
+    std::vector<std::vector<char>> model(THREADS, std::vector<char>(KEYS, 0));
+    std::atomic<int> mismatches{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&, t] {
+            std::mt19937 gen(714 + t);
+            std::vector<char>& has = model[t];
+            int keys[BATCH];
+            bool results[BATCH];
+            for (int i = 0; i < OPS; i++) {
+                int op = gen() % 3;
+                int n = gen() % 2 ? 1 : 1 + gen() % BATCH;
+                int first = gen() % (KEYS - BATCH);
+                for (int k = 0; k < n; k++) keys[k] = keyOf(t, first + k);
+
+                if (n == 1) {
+                    if (op == 0) results[0] = set.contains(keys[0]);
+                    else if (op == 1) results[0] = set.add(keys[0]);
+                    else results[0] = set.remove(keys[0]);
+                } else {
+                    if (op == 0) containsAll(set, keys, n, results);
+                    else if (op == 1) addAll(set, keys, n, results);
+                    else removeAll(set, keys, n, results);
+                }
+
+                for (int k = 0; k < n; k++) {
+                    char& present = has[first + k];
+                    bool expected = op == 1 ? !present : present;
+                    if (results[k] != expected) mismatches++;
+                    if (op == 1) present = 1;
+                    if (op == 2) present = 0;
+                }
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    CHECK(name, mismatches.load() == 0);
+
+    int expected = 0;
+    int missed = 0;
+    for (int t = 0; t < THREADS; t++) {
+        for (int j = 0; j < KEYS; j++) {
+            expected += model[t][j];
+            if (set.contains(keyOf(t, j)) != (model[t][j] != 0)) missed++;
+        }
+    }
+    CHECK(name, missed == 0);
+    CHECK(name, set.size() == expected);
+    if constexpr (HasExactSize<Set>::value) CHECK(name, set.exactSize() == expected);
+}
+
+// A value too large to sit inline in a map slot
+struct Tally {
+    long n;
+    long pad[3];
+};
+
+static void increment(long& v) {
+    v++;
+}
+
+static void increment(Tally& v) {
+    v.n++;
+}
+
+static long countOf(long v) {
+    return v;
+}
+
+static long countOf(const Tally& v) {
+    return v.n;
+}
+
+// Every thread upserts every shared key ROUNDS times, starting at 1 when it
+// inserts; each value must end at the number of upserts of its key
+template<typename V>
+void testUpsert(const char* name) {
+    static const int SHARED = 1000;
+    static const int ROUNDS = 20;
+    CuckooHashMap<int, V> map(INITIAL_CAPACITY);
+    std::atomic<int> inserted{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&, t] {
+            for (int r = 0; r < ROUNDS; r++) {
+                for (int j = 0; j < SHARED; j++) {
+                    int k = 1 + (j + t * 97) % SHARED;
+                    V one{};
+                    increment(one);
+                    if (map.upsert(k, [](V& v) { increment(v); }, one)) inserted++;
+                }
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    CHECK(name, inserted.load() == SHARED);
+    CHECK(name, map.size() == SHARED);
+    int wrong = 0;
+    for (int k = 1; k <= SHARED; k++) {
+        V v{};
+        if (!map.find(k, v) || countOf(v) != THREADS * ROUNDS) wrong++;
+    }
+    CHECK(name, wrong == 0);
+}
+
+int main() {
+    testEngine<StripedCuckooHashSet<int>>("striped");
+    testEngine<StripedCuckooHashSet<int, 8, MurmurHash, HeapAlloc, 3>>("striped, 3 tables");
+    testEngine<LockFreeCuckooHashSet<int>>("lockfree");
+    testEngine<HopscotchHashSet<int>>("hopscotch");
+    testEngine<RobinHoodHashSet<int>>("robinhood");
+    testEngine<DelegatedHashSet<int>>("delegated", 2);
+    testEngine<LockedHashSet<int>>("locked");
+    testEngine<ShardedHashSet<int, 64>>("sharded");
+#ifdef WITH_TBB
+    testEngine<TbbHashSet<int>>("tbb");
+#endif
+    testUpsert<long>("map upsert, inline values");
+    testUpsert<Tally>("map upsert, out-of-line values");
+    return report("test-parallel");
+}
@@ -0,0 +1,223 @@
+// Single-threaded tests of the striped cuckoo table (src/cuckoo): map
+// upserts with inline and out-of-line values, the stash and re-seed a bad
+// hash forces, bulk loading into every engine that supports it, and
+// snapshot round trips.
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+#include "cuckoo_map.h"
+#include "delegated_set.h"
+#include "hopscotch_set.h"
+#include "lockfree_cuckoo.h"
+#include "robin_hood_set.h"
+#include "striped_cuckoo.h"
+#include "check.h"
+
+// MurmurHash, except that under the default seed every key hashes alike, so
+// all keys share one bucket per table until the table re-seeds
+class CollidingHash {
+public:
+    static const int FUNCTIONS = MurmurHash::FUNCTIONS;
+
+    explicit CollidingHash(uint64_t seed) : murmur(seed) {}
+
+    uint64_t operator()(uint64_t x, int which) const {
+        if (murmur.seed() == 714) return (uint64_t)(which + 1) << 32;
+        return murmur(x, which);
+    }
+
+    uint64_t seed() const { return murmur.seed(); }
+
+private:
+    MurmurHash murmur;
+};
+
+// A value for key k that differs between keys
+template<typename V>
+static V valueOf(int k) {
+    if constexpr (std::is_same<V, std::string>::value) return std::to_string(k * 7);
+    else return V(k) * 7;
+}
+
+static std::string tempPath(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// Values start at the key and are bumped or appended to in place; the
+// tables start small so the keys are carried through several resizes
+static void testMapInline() {
+    const char* name = "map, inline values";
+    CuckooHashMap<int, long> map(16);
+    for (int k = 1; k <= 5000; k++) CHECK(name, map.insert(k, k));
+    CHECK(name, !map.insert(1, 0));
+    for (int k = 1; k <= 5000; k += 2) CHECK(name, !map.upsert(k, [](long& v) { v += 1000000; }, -1));
+    for (int k = 5001; k <= 6000; k++) CHECK(name, map.upsert(k, [](long& v) { v = -1; }, k));
+    CHECK(name, map.update_fn(2, [](long& v) { v = 42; }));
+    CHECK(name, !map.update_fn(6001, [](long& v) { v = 42; }));
+    for (int k = 3000; k < 3100; k++) CHECK(name, map.erase(k));
+    CHECK(name, !map.erase(3000));
+
+    int wrong = 0;
+    for (int k = 1; k <= 6001; k++) {
+        long v = 0;
+        bool found = map.find(k, v);
+        long expected = k == 2 ? 42 : k % 2 && k <= 5000 ? k + 1000000 : k;
+        if (found != (k < 3000 || (k >= 3100 && k <= 6000)) || (found && v != expected)) wrong++;
+    }
+    CHECK(name, wrong == 0);
+    CHECK(name, map.size() == 5900);
+    CHECK(name, map.exactSize() == 5900);
+}
+
+static void testMapOutOfLine() {
+    const char* name = "map, out-of-line values";
+    CuckooHashMap<int, std::string> map(16);
+    for (int k = 1; k <= 3000; k++) CHECK(name, map.upsert(k, [](std::string& v) { v += "!"; }, std::to_string(k)));
+    for (int k = 1; k <= 3000; k += 3) CHECK(name, !map.upsert(k, [](std::string& v) { v += "!"; }, "new"));
+    CHECK(name, map.update_fn(2, [](std::string& v) { v = "two"; }));
+    for (int k = 1000; k < 1010; k++) CHECK(name, map.erase(k));
+
+    int wrong = 0;
+    for (int k = 1; k <= 3000; k++) {
+        std::string v;
+        bool found = map.find(k, v);
+        std::string expected = k == 2 ? "two" : std::to_string(k) + (k % 3 == 1 ? "!" : "");
+        if (found != (k < 1000 || k >= 1010) || (found && v != expected)) wrong++;
+    }
+    CHECK(name, wrong == 0);
+    CHECK(name, map.size() == 2990);
+}
+
+// Every key lands in the same two buckets: the first 16 fill them, the next
+// 32 go to the stash without the table growing, and the one after that
+// re-seeds the table at the same size, keeping every key and its value
+template<typename V>
+static void testStash(const char* name) {
+    const int SLOTS = 8, STASHED = 32;
+    CuckooHashMap<int, V, SLOTS, CollidingHash> map(1024);
+    int capacity = map.getCapacity();
+    for (int k = 1; k <= 2 * SLOTS + STASHED; k++) CHECK(name, map.insert(k, valueOf<V>(k)));
+    TableCounters c = map.counters();
+    CHECK(name, c.stashInserts == STASHED);
+    CHECK(name, c.reseeds == 0);
+    CHECK(name, c.resizes == 0);
+
+    int last = 2 * SLOTS + STASHED + 1;
+    CHECK(name, map.insert(last, valueOf<V>(last)));
+    c = map.counters();
+    CHECK(name, c.reseeds == 1);
+    CHECK(name, c.resizes == 0);
+    CHECK(name, map.getCapacity() == capacity);
+
+    int wrong = 0;
+    for (int k = 1; k <= last; k++) {
+        V v{};
+        if (!map.find(k, v) || v != valueOf<V>(k)) wrong++;
+    }
+    CHECK(name, wrong == 0);
+    CHECK(name, map.exactSize() == last);
+}
+
+// Keys added one at a time, then a bulk load overlapping them and holding
+// duplicates of its own, into a table smaller than the result
+template<typename Set, typename... Options>
+static void testBulkLoad(const char* name, Options... options) {
+    Set set(64, options...);
+    std::unordered_set<int> model;
+    for (int k = 1; k <= 1000; k++) {
+        set.add(k * 3);
+        model.insert(k * 3);
+    }
+    std::vector<int> keys;
+    for (int k = 1; k <= 50000; k++) keys.push_back(k * 2);
+    for (int k = 1; k <= 100; k++) keys.push_back(k * 2);
+    set.bulk_load(keys.begin(), keys.end());
+    model.insert(keys.begin(), keys.end());
+
+    int wrong = 0;
+    for (int k = 1; k <= 160000; k++) {
+        if (set.contains(k) != (model.count(k) == 1)) wrong++;
+    }
+    CHECK(name, wrong == 0);
+    CHECK(name, set.size() == (int)model.size());
+}
+
+// Save a set, load it into one of another size, and keep using it; files
+// that are missing, truncated or hashed differently are refused
+static void testSnapshot() {
+    const char* name = "snapshot";
+    std::string path = tempPath("test-sequential.snapshot");
+    StripedCuckooHashSet<int> saved(1000);
+    for (int k = 1; k <= 20000; k++) saved.add(k * 5);
+    for (int k = 1; k <= 20000; k += 4) saved.remove(k * 5);
+    CHECK(name, saved.save(path));
+
+    StripedCuckooHashSet<int> loaded(64);
+    loaded.add(1);
+    CHECK(name, loaded.load(path));
+    CHECK(name, loaded.size() == saved.size());
+    CHECK(name, loaded.exactSize() == saved.exactSize());
+    CHECK(name, loaded.getCapacity() == saved.getCapacity());
+    int wrong = 0;
+    for (int k = 1; k <= 100000; k++) {
+        if (loaded.contains(k) != saved.contains(k)) wrong++;
+    }
+    CHECK(name, wrong == 0);
+
+    // The mapped arrays are copied on write; the file stays as saved
+    for (int k = 1; k <= 40000; k++) loaded.add(k * 5 + 1);
+    for (int k = 2; k <= 20000; k += 4) CHECK(name, loaded.remove(k * 5));
+    CHECK(name, loaded.exactSize() == saved.size() + 40000 - 5000);
+    StripedCuckooHashSet<int> again(64);
+    CHECK(name, again.load(path));
+    CHECK(name, again.exactSize() == saved.size());
+
+    StripedCuckooHashSet<int> refused(64);
+    refused.add(7);
+    CHECK(name, !refused.load(tempPath("test-sequential.missing")));
+    StripedCuckooHashSet<int, 8, MultiplyShiftHash> otherHash(64);
+    CHECK(name, !otherHash.load(path));
+    std::filesystem::resize_file(path, 4096 + 64);
+    CHECK(name, !refused.load(path));
+    CHECK(name, refused.exactSize() == 1 && refused.contains(7));
+    std::remove(path.c_str());
+}
+
+// Stashed keys are saved and restored with the table
+static void testSnapshotStash() {
+    const char* name = "snapshot, stashed keys";
+    std::string path = tempPath("test-sequential.stash");
+    StripedCuckooHashSet<int, 8, CollidingHash> saved(1024);
+    for (int k = 1; k <= 40; k++) CHECK(name, saved.add(k));
+    CHECK(name, saved.counters().stashInserts == 24);
+    CHECK(name, saved.save(path));
+
+    StripedCuckooHashSet<int, 8, CollidingHash> loaded(64);
+    CHECK(name, loaded.load(path));
+    int missing = 0;
+    for (int k = 1; k <= 40; k++) missing += !loaded.contains(k);
+    CHECK(name, missing == 0);
+    CHECK(name, loaded.exactSize() == 40);
+    CHECK(name, loaded.remove(40) && !loaded.contains(40));
+    std::remove(path.c_str());
+}
+
+int main() {
+    testMapInline();
+    testMapOutOfLine();
+    testStash<long>("stash and re-seed, inline values");
+    testStash<std::string>("stash and re-seed, out-of-line values");
+    testBulkLoad<StripedCuckooHashSet<int>>("bulk load, striped");
+    testBulkLoad<LockFreeCuckooHashSet<int>>("bulk load, lockfree");
+    testBulkLoad<HopscotchHashSet<int>>("bulk load, hopscotch");
+    testBulkLoad<RobinHoodHashSet<int>>("bulk load, robinhood");
+    testBulkLoad<DelegatedHashSet<int>>("bulk load, delegated", 2);
+    testSnapshot();
+    testSnapshotStash();
+    return report("test-sequential");
+}